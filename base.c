@@ -26,13 +26,17 @@
  * (with a series resistor and flyback diode to ground on each pin) and power it 
  * from a 3.3 volt boost converter.
  *
+ * The timer, the pins and the clock setup are in hal.h, which also has a port to
+ * the tinyAVR 1-series, where the RTC keeps time while the chip is in standby.
+ *
  * This file is the common infrastructure for all of the different clock types.
  * It sets up a 10 Hz interrupt. The clock code(s) keep accurate time by calling
  * either doTick() or doSleep() repeatedly. Each method will put the CPU to sleep
  * until the next tenth-of-a-second interrupt (doTick() will tick the clock once first).
- * In addition, doTick() and doSleep(), will occasionally (SEED_UPDATE_INTERVAL)
- * write out the PRNG seed (if it's changed) to EEPROM. This will insure that the clock
- * doesn't repeat its previous behavior every time you change the battery.
+ * In addition, doSleep() runs background tasks when there's time left over in the
+ * current tenth. One of those occasionally (SEED_UPDATE_INTERVAL) writes out the PRNG
+ * seed (if it's changed) to EEPROM. This will insure that the clock doesn't repeat
+ * its previous behavior every time you change the battery.
  *
  * The clock code should insure that it doesn't do so much work that works through
  * a 10 Hz interrupt interval. Every time that happens, the clock loses a tenth of
@@ -51,45 +55,57 @@
 #include <stdlib.h>
 
 #include "base.h"
+#ifdef TEMP_COMP
+#include "tempcomp.h"
+#endif
+#ifdef BATTERY_MONITOR
+#include "battery.h"
+#endif
+#ifdef TELEMETRY
+#include "telemetry.h"
+#endif
 
-#if !defined(__AVR_ATtiny44__) && !defined(__AVR_ATtiny45__)
-#error Unsupported chip
+#if defined(MOVEMENTS) && (MOVEMENTS < 1 || MOVEMENTS > 4)
+#error MOVEMENTS must be 1 to 4
+#endif
+#if defined(MOVEMENTS) && !defined(__AVR_ATtiny44__)
+#error Multiple movements need an ATtiny44
+#endif
+#if defined(TELEMETRY) && defined(SWEEP_STEPS)
+#error TELEMETRY cannot keep its bit timing with the SWEEP_STEPS sub-ticks
+#endif
+#if defined(BEMF_SENSE) && (!defined(__AVR_ATtiny45__) || defined(SWEEP_STEPS))
+#error BEMF_SENSE needs the ATtiny45, whose coil pins are the comparator inputs, and whole tick pulses
+#endif
+#if defined(PPS_DISCIPLINE) && defined(TELEMETRY)
+#error PPS_DISCIPLINE and TELEMETRY both need PB2
 #endif
+#if defined(PPS_DISCIPLINE) && defined(SWEEP_STEPS)
+#error PPS_DISCIPLINE needs the plain 10 Hz timer, not the SWEEP_STEPS sub-ticks
+#endif
+
+#include "hal.h"
 
-// 32,768 divided by (64 * 10) yields a divisor of 51 1/5, which is 52 + 51*4
-#define CLOCK_CYCLES (5)
-// Don't forget to decrement the OCR0A value - it's 0 based and inclusive
-#define CLOCK_BASIC_CYCLE (51 - 1)
-// a "long" cycle is CLOCK_BASIC_CYCLE + 1
-#define CLOCK_NUM_LONG_CYCLES (1)
+// doTickBurst() times its ticks with the timer's second compare, if there is
+// one. The other drives have their own uses for it, or their own ticks.
+#if defined(HAL_MATCH) && !defined(SWEEP_STEPS) && !defined(MOVEMENTS) && !defined(BEMF_SENSE)
+#define TICK_BURST
+#endif
 
 // One day in tenths-of-a-second
 #define SEED_UPDATE_INTERVAL 864000L
 #define EE_PRNG_SEED_LOC ((void*)0)
 #define EE_TRIM_LOC ((void*)4)
+#define EE_TEMP_CAL_LOC ((void*)6)
+#define EE_OVERRUN_MAX_LOC ((void*)8)
+#define EE_OVERRUN_TOTAL_LOC ((void*)10)
+#define EE_PULSE_LOC ((void*)14)
+#define EE_STACK_LOC ((void*)16)
 
-// clock solenoid pins
-#ifdef __AVR_ATtiny44__
-#define CLOCK_PORT PORTA
-#define P0 PORTA5
-#define P1 PORTA6
-#define CLOCK_DDR DDRA
-// To minimize power consumption all pins must be output.
-#define CLOCK_DDR_BITS (_BV(DDA0) | _BV(DDA1) | _BV(DDA2) | _BV(DDA3) | _BV(DDA4) | _BV(DDA5) | _BV(DDA6) | _BV(DDA7))
-#define EXTRA_DDR DDRB
-#define EXTRA_DDR_BITS (_BV(DDB2))
-#else
-#define CLOCK_PORT PORTB
-#define P0 PORTB0
-#define P1 PORTB1
-#define CLOCK_DDR DDRB
-// To minimize power consumption all pins must be output.
-#define CLOCK_DDR_BITS (_BV(DDB0) | _BV(DDB1) | _BV(DDB2))
-#endif
 
 // For a 32 kHz system clock speed, random() is too slow.
 // Found this at http://uzebox.org/forums/viewtopic.php?f=3&t=250
-static long seed;
+static int32_t seed; // the math below relies on 32 bit wraparound
 #define M (0x7fffffffL)
 
 unsigned long q_random() {
@@ -104,57 +120,787 @@ static void updateSeed() {
   eeprom_update_dword(EE_PRNG_SEED_LOC, seed);
 }
 
-volatile static unsigned char sleep_miss_counter = 0;
+// This is -1 while we're asleep waiting for the interrupt, 0 when we're
+// on schedule, and counts up for every interrupt we blew through. It's
+// wide enough that a long overrun won't wrap, and the ISR keeps it from
+// wrapping regardless.
+#define SLEEP_MISS_MAX (0x7fff)
+volatile static int sleep_miss_counter = 0;
+
+// Overrun telemetry. overrun_max is the most interrupts we've ever been
+// behind at once, and overrun_total is how many we've had to catch up
+// on, ever. These are kept in EEPROM along with the seed.
+unsigned int overrun_max;
+unsigned long overrun_total;
+
+#ifdef TELEMETRY
+// More for the telemetry frame. These only count since reset.
+volatile static unsigned long wakes;
+static unsigned int saves;
+static int trim_in_use;
+#endif
+
+#ifdef BEMF_SENSE
+// The tick pulse length, in ms, learned from the back-EMF. It's kept in
+// EEPROM, so a new battery starts out where the last one left off.
+static unsigned char pulse_length;
+#endif
+
+static void updateOverruns() {
+  eeprom_update_word(EE_OVERRUN_MAX_LOC, overrun_max);
+  eeprom_update_dword(EE_OVERRUN_TOTAL_LOC, overrun_total);
+}
+
+// Once a day. Each byte that has changed is a 3.4 ms EEPROM write, and each
+// write waits for the one before it, so this can take up to about 30 ms.
+static void dailySave() {
+  updateSeed();
+  updateOverruns();
+#ifdef BEMF_SENSE
+  eeprom_update_byte(EE_PULSE_LOC, pulse_length);
+#endif
+#ifdef TELEMETRY
+  saves++;
+#endif
+}
+#ifdef BEMF_SENSE
+#define DAILY_SAVE_COST (20)
+#else
+#define DAILY_SAVE_COST (18)
+#endif
+
+#ifdef STACK_PAINT
+// How close has the stack come to the static variables? At reset, all of
+// the RAM between the end of .bss and the stack is painted with
+// STACK_PAINT_BYTE. Whatever's still painted later was never used, so the
+// paint left just past .bss is the least room the stack has ever had to
+// spare. Once an hour, that goes in EEPROM, at EE_STACK_LOC. It's since
+// the last reset, so a new build starts over.
+#define STACK_PAINT_BYTE (0xc5)
+#define STACK_CHECK_INTERVAL (36000L)
+// avr-libc's linker script puts this at the end of .bss.
+extern unsigned char __heap_start;
+
+static unsigned int stack_headroom = 0xffff;
+
+// Everything below where the stack is now.
+static void __attribute__((noinline)) paintStack() {
+  for(unsigned char *p = &__heap_start; (uintptr_t)p < SP; p++)
+    *p = STACK_PAINT_BYTE;
+}
+
+static void updateStack() {
+  unsigned char *p = &__heap_start;
+  while((uintptr_t)p <= RAMEND && *p == STACK_PAINT_BYTE) p++;
+  unsigned int headroom = p - &__heap_start;
+  if (headroom < stack_headroom) {
+    stack_headroom = headroom;
+    eeprom_update_word(EE_STACK_LOC, headroom);
+  }
+}
+// Looking at all 256 bytes, and an EEPROM write.
+#define STACK_COST (28)
+#endif
 
 volatile unsigned long trim_cycles;
 volatile char trim_offset;
+// How many timer counts are left until the next trim nudge.
+volatile static unsigned long trim_pos;
+// Which of the CLOCK_CYCLES timer periods is running now.
+volatile static unsigned char cycle_pos;
 
-static unsigned long seed_update_timer;
+#ifdef SWEEP_STEPS
+// Which sub-tick of the tenth we're in.
+volatile static unsigned char subtick;
+// Steps still to be taken, and how many sub-ticks apart to take them.
+volatile static unsigned char step_backlog;
+volatile static unsigned char step_spacing = SUBTICKS_PER_STEP;
+#endif
 
-void doSleep() {
+// Room for base.c's own tasks, plus a couple for the clock code.
+#ifndef MAX_TASKS
+#define MAX_TASKS (6)
+#endif
+
+struct task {
+  void (*run)();
+  unsigned long period;
+  unsigned long countdown;
+  unsigned char cost;
+};
+static struct task tasks[MAX_TASKS];
+static unsigned char task_count;
+
+void addTask(void (*run)(), unsigned long period, unsigned char cost) {
+  if (task_count >= MAX_TASKS) return;
+  struct task *t = &tasks[task_count++];
+  t->run = run;
+  t->period = period;
+  t->countdown = period;
+  t->cost = cost;
+}
+
+// Is there more than the given number of timer counts left before the next
+// interrupt? If we're behind, or the interrupt is pending, there's no time at
+// all.
+#ifdef TICK_BURST
+// Ticks not yet over, counting the one that's on. See doTickBurst().
+volatile static unsigned char burst_left;
+#endif
+
+static unsigned char haveTime(unsigned char cost) {
+  unsigned int left;
+#ifdef TICK_BURST
+  // Sleep through the burst - a task could hold off the end of a tick.
+  if (burst_left) return 0;
+#endif
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    left = sleep_miss_counter != 0 ? 0 : halCountsLeft();
+#ifdef SWEEP_STEPS
+    // That's only to the next sub-tick, in counts of 8 cycles. Tasks
+    // have all of the rest of the tenth.
+    if (left)
+      left = (left + (SUBTICKS_PER_TENTH - 1 - subtick) * (CLOCK_BASIC_CYCLE + 1)) / 8;
+#endif
+  }
+  return left > cost * HAL_COST_COUNTS;
+}
+
+// Every task counts down once per tenth. Once it's due, it stays due until
+// there's time to run it.
+static void runTasks() {
+  for(unsigned char i = 0; i < task_count; i++) {
+    struct task *t = &tasks[i];
+    if (t->countdown != 0 && --t->countdown != 0) continue; // not yet
+    if (!haveTime(t->cost)) continue; // maybe next time
+    t->run();
+    t->countdown = t->period;
+  }
+}
+
+// This is the trim factor from EEPROM. Anything else that wants to adjust
+// the clock rate does so relative to this.
+static int trim_base;
+
+static void setTrim(int trim_value) {
+  unsigned long cycles = 0;
+  char offset = 0;
+  if (trim_value != 0) {
+    cycles = 10000000 / abs(trim_value); // how often do we nudge by 1 unit?
+    offset = (trim_value < 0)?-1:1; // signum - which direction?
+  }
+  // The ISR uses both of these, so they must change together.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    trim_cycles = cycles;
+    trim_offset = offset;
+    // A nudge still pending from a weaker trim could be up to 10,000,000
+    // counts off. Don't make the new one wait longer than its own interval.
+    if (trim_pos > cycles) trim_pos = cycles;
+  }
+#ifdef TELEMETRY
+  trim_in_use = trim_value;
+#endif
+}
 
-  if (--seed_update_timer == 0) {
-    updateSeed();
-    seed_update_timer = SEED_UPDATE_INTERVAL;
+#ifdef PPS_DISCIPLINE
+// A reference pulse once a second - a GPS module's 1PPS, say - on INT0
+// (PB2) steers the trim. The edge interrupt notes where in our own time each
+// rising edge lands, and a task once a PPS_UPDATE_INTERVAL turns the average
+// error into a correction. Without the reference, the last rate it learned
+// stays in effect.
+#define PPS_PORT PORTB
+#define PPS_PIN PORTB2
+#ifdef __AVR_ATtiny44__
+#define PPS_VECT EXT_INT0_vect
+#else
+#define PPS_VECT INT0_vect
+#endif
+// About a minute of edges.
+#define PPS_UPDATE_INTERVAL (640)
+// 200 ppm. More than that, and it's not the crystal.
+#define PPS_MAX_TRIM (2000)
+
+// Where the edges should land, in timer counts - see the ISR.
+volatile static unsigned char pps_target;
+volatile static unsigned char pps_locked;
+// The errors of the edges since the last update, in timer counts.
+volatile static int pps_sum;
+volatile static unsigned char pps_count;
+// The loop's integral term, in sixteenths of a trim unit, and what the loop
+// adds to trim_base.
+static long pps_integral;
+static int pps_trim;
+
+#ifdef TEMP_COMP
+static void updateTemp();
+#endif
+
+// A PI loop. Each timer count of average error asks for 3.2 ppm, and adds
+// 0.1 ppm to the integral every update. From a crystal 15 ppm off, it pulls
+// the phase back in within the hour.
+static void updatePPS() {
+  int sum;
+  unsigned char count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    sum = pps_sum;
+    count = pps_count;
+    pps_sum = 0;
+    pps_count = 0;
   }
+  if (count == 0) {
+    // It's gone. Hold the rate, and when it comes back, lock on to
+    // wherever it is then, rather than drag the hand over to it.
+    pps_locked = 0;
+    pps_trim = pps_integral >> 4;
+  } else {
+    // In sixteenths of a timer count. Positive means we're fast, which
+    // takes a positive trim.
+    int error = ((long)sum << 4) / count;
+    pps_integral += error;
+    if (pps_integral > (long)PPS_MAX_TRIM << 4) pps_integral = (long)PPS_MAX_TRIM << 4;
+    if (pps_integral < -((long)PPS_MAX_TRIM << 4)) pps_integral = -((long)PPS_MAX_TRIM << 4);
+    long trim = (pps_integral >> 4) + 2 * (long)error;
+    if (trim > PPS_MAX_TRIM) trim = PPS_MAX_TRIM;
+    if (trim < -PPS_MAX_TRIM) trim = -PPS_MAX_TRIM;
+    pps_trim = trim;
+  }
+#ifdef TEMP_COMP
+  updateTemp(); // that applies it, along with the temperature correction
+#else
+  setTrim(trim_base + pps_trim);
+#endif
+}
+// Two long divisions, here and in setTrim().
+#ifdef TEMP_COMP
+#define PPS_COST (26)
+#else
+#define PPS_COST (24)
+#endif
+#endif
+
+#if defined(TEMP_COMP) || defined(BATTERY_MONITOR)
+// The ADC is only powered up for the duration of this call. With the ADC
+// prescaler at 2, the conversions take 25 + 13 ADC clocks, which is about
+// 80 CPU cycles. The first conversion after turning on the reference is
+// thrown away - it also covers the reference start-up time.
+static int readADC(unsigned char admux) {
+  power_adc_enable();
+  ADMUX = admux;
+  ADCSRA = _BV(ADEN) | _BV(ADSC);
+  while(ADCSRA & _BV(ADSC)) ;
+  ADCSRA |= _BV(ADSC);
+  while(ADCSRA & _BV(ADSC)) ;
+  int result = ADC;
+  ADCSRA = 0;
+  power_adc_disable();
+  return result;
+}
+#endif
+
+#ifdef TEMP_COMP
+#ifdef __AVR_ATtiny44__
+// Internal 1.1 volt reference, ADC8 (the temperature sensor)
+#define TEMP_ADMUX (_BV(REFS1) | _BV(MUX5) | _BV(MUX1))
+#else
+// Internal 1.1 volt reference, ADC4 (the temperature sensor)
+#define TEMP_ADMUX (_BV(REFS1) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1) | _BV(MUX0))
+#endif
+
+static int temp_cal;
+
+static void updateTemp() {
+  int trim = trim_base + tempCorrection(readADC(TEMP_ADMUX), temp_cal);
+#ifdef PPS_DISCIPLINE
+  trim += pps_trim;
+#endif
+  setTrim(trim);
+}
+// The ADC is quick, but setTrim() does a long division.
+#define TEMP_COST (12)
+#endif
+
+#ifdef BATTERY_MONITOR
+#ifdef __AVR_ATtiny44__
+// VCC reference, measuring the 1.1 volt bandgap
+#define VCC_ADMUX (_BV(MUX5) | _BV(MUX0))
+#else
+// VCC reference, measuring the 1.1 volt bandgap
+#define VCC_ADMUX (_BV(MUX3) | _BV(MUX2))
+#endif
+
+static unsigned char battery_level = BATTERY_OK;
+
+// The battery never gets better (until it's changed, which is a reset),
+// so the level only ever goes up.
+static void updateBattery() {
+  unsigned char level = batteryLevel(readADC(VCC_ADMUX));
+  if (level > battery_level) battery_level = level;
+}
+#define BATTERY_COST (3)
+
+static void batteryFallback();
+#endif
+
+#ifdef TELEMETRY
+// The serial line is PB2 on either chip. It idles high.
+#define TELEMETRY_PORT PORTB
+#define TELEMETRY_PIN PORTB2
+#define TELEMETRY_BIT_CYCLES (F_CPU / TELEMETRY_BAUD)
+// sendByte()'s bit loop, from one edge to the next, is TELEMETRY_LOOP_CYCLES
+// plus 3 a pass around the wait, plus the odd nops. It's written out in
+// assembly so that those are the instructions' own cycle counts, whatever
+// the compiler does - see the counts alongside it. 'make -C host check' adds
+// them up again (host/bitloop.py).
+#define TELEMETRY_LOOP_CYCLES (9)
+#define TELEMETRY_WAIT_PASSES ((TELEMETRY_BIT_CYCLES - TELEMETRY_LOOP_CYCLES) / 3)
+#define TELEMETRY_WAIT_NOPS ((TELEMETRY_BIT_CYCLES - TELEMETRY_LOOP_CYCLES) % 3)
+#if TELEMETRY_WAIT_PASSES < 1 || TELEMETRY_WAIT_PASSES > 255
+#error TELEMETRY_BAUD is out of reach of the bit loop at this F_CPU
+#endif
+
+static struct telemetry_frame frame;
+static unsigned char frame_pos = sizeof(frame); // nothing to send yet
+static unsigned long last_frame;
+
+// A start bit, 8 data bits (LSB first) and a stop bit - about 33 ms. No
+// interrupt may stretch a bit, but the task only runs with the time to spare.
+static void sendByte(unsigned char b) {
+  unsigned int bits = (b << 1) | 0x200;
+#ifdef __AVR__
+  unsigned char count = 10, port, wait;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    // The pin is set from a copy of the port, so the edge is always the out.
+    __asm__ __volatile__ (
+      "1: in %[port], %[io]\n\t"     // 1
+      "bst %A[bits], 0\n\t"          // 1
+      "bld %[port], %[pin]\n\t"      // 1
+      "out %[io], %[port]\n\t"       // 1
+      "lsr %B[bits]\n\t"             // 1
+      "ror %A[bits]\n\t"             // 1
+      "ldi %[wait], %[passes]\n\t"   // 1
+      "2: dec %[wait]\n\t"           // 1 a pass
+      "brne 2b\n\t"                  // 2 a pass, but 1 the last time
+      ".rept %[nops]\n\tnop\n\t.endr\n\t" // 1 each
+      "dec %[count]\n\t"             // 1
+      "brne 1b\n\t"                  // 2
+      : [bits] "+r" (bits), [count] "+r" (count), [port] "=&r" (port), [wait] "=&d" (wait)
+      : [io] "I" (_SFR_IO_ADDR(TELEMETRY_PORT)), [pin] "I" (TELEMETRY_PIN),
+        [passes] "M" (TELEMETRY_WAIT_PASSES), [nops] "n" (TELEMETRY_WAIT_NOPS)
+    );
+  }
+#else
+  // The host simulator's code takes no time, so the bit is all delay.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for(unsigned char i = 0; i < 10; i++) {
+      if (bits & 1)
+        TELEMETRY_PORT |= _BV(TELEMETRY_PIN);
+      else
+        TELEMETRY_PORT &= ~_BV(TELEMETRY_PIN);
+      bits >>= 1;
+      __builtin_avr_delay_cycles(TELEMETRY_BIT_CYCLES);
+    }
+  }
+#endif
+}
+
+// This is a task that runs every tenth it can. Once a TELEMETRY_INTERVAL, it
+// takes a snapshot of the counters, then sends it a byte at a time.
+static void sendTelemetry() {
+  if (frame_pos >= sizeof(frame)) {
+    unsigned long now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      now = wakes;
+    }
+    if (now - last_frame < TELEMETRY_INTERVAL) return;
+    last_frame = now;
+    frame.sync = TELEMETRY_SYNC;
+    frame.sequence++;
+    frame.wakes = now;
+    frame.overrun_max = overrun_max;
+    frame.overrun_total = overrun_total;
+    frame.saves = saves;
+    frame.trim = trim_in_use;
+#ifdef BATTERY_MONITOR
+    frame.battery = battery_level;
+#else
+    frame.battery = TELEMETRY_NO_BATTERY;
+#endif
+    frame.check = 0;
+    frame.check = -telemetrySum(&frame);
+    frame_pos = 0;
+  }
+  sendByte(((unsigned char *)&frame)[frame_pos++]);
+}
+// One byte, plus putting the frame together.
+#define TELEMETRY_COST ((10 * TELEMETRY_BIT_CYCLES + 300) / 64)
+#endif
+
+#ifdef MOVEMENTS
+static void sendPulses();
+#endif
+
+#ifdef SWEEP_STEPS
+static void updateStepSpacing();
+#endif
+
+void doSleep() {
+
+#ifdef MOVEMENTS
+  sendPulses();
+#endif
+#ifdef SWEEP_STEPS
+  updateStepSpacing();
+#endif
+
+  runTasks();
+
+#ifdef BATTERY_MONITOR
+  if (battery_level == BATTERY_CRITICAL) batteryFallback(); // never returns
+#endif
 
   // If we missed a sleep, then try and catch up by *not* sleeping.
   // Note that the test-and-decrememnt must be atomic, so save a
   // copy of the present value before decrementing and use that
   // copy for the decision.
-  unsigned char local_smc;
+  int local_smc;
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
     local_smc = sleep_miss_counter--;
   }
-  if (local_smc == 0)
+  if (local_smc == 0) {
+#if defined(SWEEP_STEPS) || defined(PPS_DISCIPLINE) || defined(TICK_BURST)
+    // The sub-ticks, the reference edges and the tick bursts wake us up, too.
+    // Only the end of the tenth brings sleep_miss_counter back up to 0.
+    // Reading it isn't atomic, but the low byte comes first, so a torn read
+    // of -1 becoming 0 still reads as done.
+    do {
+      sleep_mode();
+    } while(sleep_miss_counter < 0);
+#else
     sleep_mode(); // this results in sleep_miss_counter being incremented.
+#endif
+  } else {
+    // We're behind. Each of these is one tenth we had to make up.
+    if (local_smc > overrun_max) overrun_max = local_smc;
+    if (overrun_total < 0xfffffffeL) overrun_total++; // all ones would read back as unset
+  }
 }
 
 // How long is each tick pulse?
 #define TICK_LENGTH (30)
+// How long is each tick pulse when the battery is low?
+#ifndef TICK_LENGTH_LOW
+#define TICK_LENGTH_LOW (20)
+#endif
+
+#if !defined(SWEEP_STEPS) && !defined(BEMF_SENSE)
+static void tickDelay() {
+#ifdef BATTERY_MONITOR
+  // _delay_ms() needs a constant.
+  if (battery_level != BATTERY_OK)
+    _delay_ms(TICK_LENGTH_LOW);
+  else
+#endif
+  _delay_ms(TICK_LENGTH);
+}
+#endif
+
+#ifdef SWEEP_STEPS
+// A tick is a second's worth of steps. The sub-tick interrupt takes them,
+// one every step_spacing sub-ticks.
+void doTick() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    step_backlog = (step_backlog > 0xff - SWEEP_STEPS) ? 0xff : step_backlog + SWEEP_STEPS;
+  }
+  doSleep(); // eat the rest of this tick
+}
+
+// Normally the steps are SUBTICKS_PER_STEP sub-ticks apart, which is
+// SWEEP_STEPS a second. If the clock code ticks faster than once a second,
+// the steps pile up, so speed up enough to take them all in about a second.
+static void updateStepSpacing() {
+  unsigned char backlog = step_backlog;
+  unsigned char spacing = SUBTICKS_PER_STEP;
+  if (backlog > SWEEP_STEPS) {
+    spacing = SUBTICKS_PER_SECOND / backlog;
+    if (spacing == 0) spacing = 1;
+  }
+  step_spacing = spacing;
+}
+
+// The end of a step pulse.
+ISR(TIM0_COMPB_vect) {
+  halCoilOff(P0);
+  halCoilOff(P1);
+  TIMER_MASK &= ~_BV(OCIE0B);
+}
+#elif defined(MOVEMENTS)
+// Each movement has its own pair of coil pins on PORTA, and its own
+// polarity. The first pair is the same as the single movement build.
+static const unsigned char coil_a[] = { _BV(PORTA5), _BV(PORTA0), _BV(PORTA2), _BV(PORTA4) };
+static const unsigned char coil_b[] = { _BV(PORTA6), _BV(PORTA1), _BV(PORTA3), _BV(PORTA7) };
+static unsigned char polarity;
+
+// The pulses are sent one after another, so that only one coil is ever
+// drawing current. Only so many fit in a tenth. Any more wait for the next
+// tenth, so a tick can be late, but is never lost.
+#ifndef PULSES_PER_TENTH
+#define PULSES_PER_TENTH (2)
+#endif
+static unsigned char pending[MOVEMENTS];
+static unsigned char next_movement; // round-robin, so nobody waits forever
+
+static void sendPulses() {
+  unsigned char sent = 0;
+  for(unsigned char n = 0; n < MOVEMENTS && sent < PULSES_PER_TENTH; n++) {
+    unsigned char i = next_movement;
+    if (++next_movement >= MOVEMENTS) next_movement = 0;
+    if (pending[i] == 0) continue;
+    pending[i]--;
+    unsigned char pin = (polarity & _BV(i)) ? coil_b[i] : coil_a[i];
+    polarity ^= _BV(i);
+    CLOCK_PORT |= pin;
+    tickDelay();
+    CLOCK_PORT &= ~pin;
+    sent++;
+  }
+}
+
+// Tick every movement whose bit is set. This eats one interrupt "tick", just
+// like doTick().
+void doTickMask(unsigned char mask) {
+  for(unsigned char i = 0; i < MOVEMENTS; i++)
+    if (mask & _BV(i)) pending[i]++;
+  doSleep(); // that sends them
+}
+
+void doTick() {
+  doTickMask(1);
+}
+#elif defined(BEMF_SENSE)
+// The coil is between PB0 and PB1, which are also AIN0 and AIN1. After each
+// pulse, the coil is left floating and the comparator watches its back-EMF.
+// If the rotor made it past the detent, it's still turning the same way and
+// the pin that was driven reads higher than the other. If it didn't, it
+// falls back, and it reads the other way.
+//
+// The pulse starts out TICK_LENGTH long and is shortened by a ms after every
+// BEMF_PROBE_TICKS good steps in a row. A missed step gets a full length
+// pulse straight away - on the same pin, since the rotor hasn't moved - and
+// the pulse goes back up by BEMF_BACKOFF. So it settles a little above the
+// shortest pulse this movement, on this battery, reliably takes.
+#ifndef BEMF_MIN_PULSE
+#define BEMF_MIN_PULSE (6)
+#endif
+#ifndef BEMF_BACKOFF
+#define BEMF_BACKOFF (2)
+#endif
+// An hour of ticks.
+#ifndef BEMF_PROBE_TICKS
+#define BEMF_PROBE_TICKS (3600)
+#endif
+// Samples are taken this far apart, after waiting out the flyback.
+#define BEMF_SETTLE_US (1000)
+#define BEMF_SAMPLE_US (500)
+#define BEMF_SAMPLES (8)
+
+// _delay_ms() needs a constant, so this is about a ms at a time.
+static void pulse(unsigned char pin, unsigned char ms) {
+  halCoilOn(pin);
+  while(ms--) _delay_ms(1);
+  halCoilOff(pin);
+}
+
+static unsigned char stepped(unsigned char pin) {
+  unsigned char agree = 0;
+  CLOCK_DDR &= ~(_BV(P0) | _BV(P1));
+  ACSR = 0; // comparator on, AIN0 against AIN1
+  _delay_us(BEMF_SETTLE_US);
+  for(unsigned char i = 0; i < BEMF_SAMPLES; i++) {
+    unsigned char high = (ACSR & _BV(ACO)) != 0;
+    if (high == (pin == P0)) agree++;
+    _delay_us(BEMF_SAMPLE_US);
+  }
+  ACSR = _BV(ACD);
+  CLOCK_DDR |= _BV(P0) | _BV(P1);
+  return agree > BEMF_SAMPLES / 2;
+}
 
-// This will alternate the ticks
 #define TICK_PIN (lastTick == P0?P1:P0)
 
-// Each call to doTick() will "eat" a single one of our interrupt "ticks"
 void doTick() {
-  static unsigned char lastTick; // Doesn't matter that it's uninitialized.
+  static unsigned char lastTick;
+  static unsigned int good_steps;
+  unsigned char limit = TICK_LENGTH;
+#ifdef BATTERY_MONITOR
+  if (battery_level != BATTERY_OK) limit = TICK_LENGTH_LOW;
+#endif
 
-  CLOCK_PORT |= _BV(TICK_PIN);
-  _delay_ms(TICK_LENGTH);
-  CLOCK_PORT &= ~ _BV(TICK_PIN);
+  pulse(TICK_PIN, pulse_length < limit ? pulse_length : limit);
+  if (stepped(TICK_PIN)) {
+    if (++good_steps >= BEMF_PROBE_TICKS) {
+      good_steps = 0;
+      if (pulse_length > BEMF_MIN_PULSE) pulse_length--;
+    }
+  } else {
+    pulse(TICK_PIN, limit);
+    good_steps = 0;
+    pulse_length = (pulse_length > TICK_LENGTH - BEMF_BACKOFF) ? TICK_LENGTH : pulse_length + BEMF_BACKOFF;
+  }
   lastTick = TICK_PIN;
   doSleep(); // eat the rest of this tick
 }
+#else
+// This will alternate the ticks. It starts at 0, so the first tick is on P1,
+// and it stays out of .data.
+static unsigned char last_on_p1;
+#define LAST_PIN (last_on_p1?P1:P0)
+#define TICK_PIN (last_on_p1?P0:P1)
 
-ISR(TIM0_COMPA_vect) {
-  static unsigned char cycle_pos = 0;
-  static unsigned long trim_pos = 0;
+// Each call to doTick() will "eat" a single one of our interrupt "ticks"
+void doTick() {
+  halCoilOn(TICK_PIN);
+  tickDelay();
+  halCoilOff(TICK_PIN);
+  last_on_p1 = !last_on_p1;
+  doSleep(); // eat the rest of this tick
+}
+#endif
+
+#ifdef TICK_BURST
+// A burst is a train of compare matches, each one starting or ending a tick.
+// burst_next is where the next one is due, in timer counts from the start of
+// this period. When that isn't in this period, the period's own interrupt
+// carries it over into the next one.
+volatile static unsigned char burst_on;
+volatile static int burst_next;
+static unsigned char burst_width;
+static unsigned int burst_gap;
+// The top of the period before this one. See doTickBurst().
+volatile static unsigned char burst_old_top;
+
+static void burstArm() {
+  // The counter only reaches the top for one count, so that's left to the
+  // next period, which starts a count later.
+  if (burst_next < HAL_TIMER_TOP) {
+    HAL_MATCH = burst_next;
+    halMatchOn();
+  } else {
+    halMatchOff();
+  }
+}
+
+ISR(HAL_MATCH_VECT) {
+  if (burst_on) {
+    halCoilOff(LAST_PIN);
+    burst_on = 0;
+    if (--burst_left == 0) {
+      halMatchOff();
+      return;
+    }
+    burst_next += burst_gap - burst_width;
+  } else {
+    last_on_p1 = !last_on_p1;
+    halCoilOn(LAST_PIN);
+    burst_on = 1;
+    burst_next += burst_width;
+  }
+  burstArm();
+}
+
+unsigned int doTickBurst(unsigned char count, unsigned int spacing) {
+  if (count == 0) return 0;
+  if (spacing < BURST_MIN_SPACING) spacing = BURST_MIN_SPACING;
+  if (spacing > BURST_MAX_SPACING) spacing = BURST_MAX_SPACING;
+  burst_width = HAL_MS_COUNTS(TICK_LENGTH);
+#ifdef BATTERY_MONITOR
+  if (battery_level != BATTERY_OK) burst_width = HAL_MS_COUNTS(TICK_LENGTH_LOW);
+#endif
+  burst_gap = HAL_MS_COUNTS(spacing);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    // The first tick starts now, just like doTick()'s.
+    last_on_p1 = !last_on_p1;
+    halCoilOn(LAST_PIN);
+    burst_on = 1;
+    burst_left = count;
+    // Just after the period's interrupt, the counter still reads the old top,
+    // and the period starts a count later. If the period's over and its
+    // interrupt is still to come, that carries this over.
+    int now = HAL_COUNT;
+    if (halCountsLeft() == 0) now = HAL_TIMER_TOP;
+    else if (now == burst_old_top) now = -1;
+    burst_next = now + burst_width;
+    burstArm();
+  }
+  unsigned int tenths = 0;
+  do {
+    doSleep();
+    tenths++;
+  } while(burst_left);
+  return tenths;
+}
+
+#ifdef BATTERY_MONITOR
+// Whatever's left of the burst is dropped.
+static void burstStop() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    halMatchOff();
+    if (burst_on) halCoilOff(LAST_PIN);
+    burst_on = 0;
+    burst_left = 0;
+  }
+}
+#endif
+#else
+// The ticks are doTick()s, with the spacing rounded to whole tenths.
+unsigned int doTickBurst(unsigned char count, unsigned int spacing) {
+  if (spacing < BURST_MIN_SPACING) spacing = BURST_MIN_SPACING;
+  if (spacing > BURST_MAX_SPACING) spacing = BURST_MAX_SPACING;
+  unsigned char gap = (spacing + 50) / 100;
+  if (gap == 0) gap = 1;
+  unsigned int tenths = 0;
+  while(count != 0) {
+    doTick();
+    tenths++;
+    if (--count == 0) break;
+    for(unsigned char i = 1; i < gap; i++) {
+      doSleep();
+      tenths++;
+    }
+  }
+  return tenths;
+}
+#endif
+
+#ifdef BATTERY_MONITOR
+// The battery is nearly dead. Abandon the clock code and just tick once a
+// second, so the only work left is the tick itself. This takes over from
+// whatever doSleep() call noticed, so that call's tenth becomes the first
+// tick. Whatever offset the clock code had built up at that moment stays.
+static void batteryFallback() {
+  battery_level = BATTERY_FALLBACK; // so doSleep() won't come back here
+#ifdef TICK_BURST
+  burstStop();
+#endif
+  while(1) {
+#ifdef MOVEMENTS
+    doTickMask(_BV(MOVEMENTS) - 1);
+#else
+    doTick();
+#endif
+    for(unsigned char i = 0; i < IRQS_PER_SECOND - 1; i++)
+      doSleep();
+  }
+}
+#endif
+
+ISR(HAL_TIMER_VECT) {
+  halAck();
 
   char offset = 0;
   if (trim_offset != 0) {
-    // This is how many crystal cycles we just went through.
-    unsigned long crystal_cycles = OCR0A;
+    // This is how many timer counts we just went through. The top is
+    // inclusive, so it's one more than the register.
+    unsigned long crystal_cycles = HAL_TIMER_TOP + 1;
     if (trim_pos < crystal_cycles) {
       trim_pos += trim_cycles; // how often do we nudge by 1 unit?
       offset = trim_offset; // which direction?
@@ -170,67 +916,169 @@ ISR(TIM0_COMPA_vect) {
   if (++cycle_pos >= CLOCK_CYCLES) cycle_pos = 0;
 
   // because offset will change from 0 to +/- 1 for one cycle,
-  // that means we have to set OCR0A *every* time.
+  // that means we have to set the top *every* time.
+#ifdef TICK_BURST
+  // The burst's next match, from the start of the period that starts now.
+  if (burst_left) {
+    burst_next -= HAL_TIMER_TOP + 1;
+    if (burst_next < 0) burst_next = 0; // a count late
+  }
+  burst_old_top = HAL_TIMER_TOP;
+#endif
+
   if (cycle_pos >= CLOCK_NUM_LONG_CYCLES)
-    OCR0A = ((char)CLOCK_BASIC_CYCLE) + offset;
+    HAL_TIMER_TOP = CLOCK_BASIC_CYCLE + offset;
   else
-    OCR0A = ((char)(CLOCK_BASIC_CYCLE + 1)) + offset;
+    HAL_TIMER_TOP = CLOCK_BASIC_CYCLE + 1 + offset;
+
+#ifdef TICK_BURST
+  if (burst_left) burstArm();
+#endif
+
+#ifdef SWEEP_STEPS
+  // Take a step if one is due.
+  static unsigned char step_wait = 0xff;
+  static unsigned char step_pin;
+  if (step_wait < 0xff) step_wait++;
+  if (step_backlog != 0 && step_wait >= step_spacing) {
+    step_wait = 0;
+    step_backlog--;
+    step_pin = (step_pin == P0) ? P1 : P0;
+    halCoilOn(step_pin);
+    TIMER_FLAGS = _BV(OCF0B); // it matched last time around, too
+    TIMER_MASK |= _BV(OCIE0B);
+  }
+
+  // The rest is only for the last sub-tick of the tenth.
+  if (++subtick < SUBTICKS_PER_TENTH) return;
+  subtick = 0;
+#endif
+
+#ifdef TELEMETRY
+  wakes++;
+#endif
 
   // Keep track of any interrupts we blew through.
   // Every increment here *should* be matched by
-  // a decrement in doSleep();
-  sleep_miss_counter++;
+  // a decrement in doSleep(); If it's gotten this
+  // far behind, that time is just lost.
+  if (sleep_miss_counter < SLEEP_MISS_MAX)
+    sleep_miss_counter++;
 }
 
+#ifdef PPS_DISCIPLINE
+ISR(PPS_VECT) {
+  // The counter keeps going while we look, so make sure the flag and the
+  // count go together.
+  unsigned char pending, now;
+  do {
+    pending = TIMER_FLAGS & _BV(OCF0A);
+    now = TCNT0;
+  } while(pending != (TIMER_FLAGS & _BV(OCF0A)));
+  unsigned char top = OCR0A;
+  // Our own time since the start of this run of CLOCK_CYCLES timer periods,
+  // in timer counts. That's exactly 256, half a second, so it wraps just
+  // like a byte does, and a whole second later it's back where it was. Each
+  // period starts at the compare match that ends the one before - when its
+  // interrupt runs, the counter still shows the old top for one more count.
+  unsigned char pos = cycle_pos;
+  unsigned char phase = pos * (CLOCK_BASIC_CYCLE + 1) + (pos < CLOCK_NUM_LONG_CYCLES ? pos : CLOCK_NUM_LONG_CYCLES);
+  if (pending) {
+    // This period's over, but its interrupt hasn't run yet.
+    phase += top + 1;
+    if (now < top) phase += now + 1;
+  } else if (now < top) {
+    phase += now + 1;
+  }
+  if (!pps_locked) {
+    pps_target = phase;
+    pps_locked = 1;
+  }
+  if (pps_count == 0xff) return; // the task is way behind
+  pps_sum += (signed char)(phase - pps_target);
+  pps_count++;
+}
+#endif
+
 extern void loop();
 
 // main() is void, and we never return from it.
 void __ATTR_NORETURN__ main() {
-  ADCSRA = 0; // DIE, ADC!!! DIE!!!
-  ACSR = _BV(ACD); // Turn off analog comparator - but was it ever on anyway?
-  power_adc_disable();
-  power_usi_disable();
-  power_timer1_disable();
-  TCCR0A = _BV(WGM01); // mode 2 - CTC
-  TCCR0B = _BV(CS01) | _BV(CS00); // prescale = 64
-#ifdef __AVR_ATtiny44__
-  TIMSK0 = _BV(OCIE0A); // OCR0A interrupt only.
-#else
-  TIMSK = _BV(OCIE0A); // OCR0A interrupt only.
+#ifdef STACK_PAINT
+  paintStack(); // before anything else is on it
 #endif
-  
-  set_sleep_mode(SLEEP_MODE_IDLE);
-
-  CLOCK_DDR = CLOCK_DDR_BITS;
-#ifdef __AVR_ATtiny44__
-  EXTRA_DDR = EXTRA_DDR_BITS;
+  halInit();
+#ifdef BEMF_SENSE
+  // The coil pins only float while the comparator is looking at them, but
+  // the digital inputs would draw current then.
+  DIDR0 = _BV(AIN0D) | _BV(AIN1D);
+  pulse_length = eeprom_read_byte(EE_PULSE_LOC);
+  if (pulse_length < BEMF_MIN_PULSE || pulse_length > TICK_LENGTH) pulse_length = TICK_LENGTH;
+#endif
+#ifdef TELEMETRY
+  TELEMETRY_PORT |= _BV(TELEMETRY_PIN); // except the idle serial line
+#endif
+#ifdef PPS_DISCIPLINE
+  // The pull-up keeps it quiet with nothing plugged in. set_sleep_mode()
+  // shares MCUCR with the edge select.
+  PPS_PORT |= _BV(PPS_PIN);
+  MCUCR |= _BV(ISC01) | _BV(ISC00); // rising edge
+  GIMSK = _BV(INT0);
 #endif
-  CLOCK_PORT = 0; // Initialize all pins low.
 
   // we pre-compute all of this stuff to save cycles later.
   // These values never change after startup.
   // The uninitialized value of 0xffff is actually rather harmless.
   // It's the signed int -1, which speeds up the clock by 0.1 ppm.
-  int trim_value = (int)eeprom_read_word(EE_TRIM_LOC);
-  if (trim_value != 0) {
-    trim_cycles = 10000000 / abs(trim_value); // how often do we nudge by 1 unit?
-    trim_offset = (trim_value < 0)?-1:1; // signum - which direction?
-  } else
-    trim_offset = 0;
+  trim_base = (int16_t)eeprom_read_word(EE_TRIM_LOC);
+  setTrim(trim_base);
+
+#ifdef TEMP_COMP
+  // This is the sensor reading at the crystal's turnover temperature.
+  // If it was never set, then use the typical value.
+  temp_cal = (int16_t)eeprom_read_word(EE_TEMP_CAL_LOC);
+  if (temp_cal == -1) temp_cal = TEMP_DEFAULT_CAL;
+  updateTemp();
+  addTask(updateTemp, TEMP_SAMPLE_INTERVAL, TEMP_COST);
+#endif
+
+#ifdef BATTERY_MONITOR
+  updateBattery();
+  addTask(updateBattery, BATTERY_CHECK_INTERVAL, BATTERY_COST);
+#endif
 
   // Try and perturb the PRNG as best as we can
-  seed = (long)eeprom_read_dword(EE_PRNG_SEED_LOC);
+  seed = (int32_t)eeprom_read_dword(EE_PRNG_SEED_LOC);
   // it can't be all 0 or all 1
   if (seed == 0 || ((seed & M) == M)) seed=0x12345678L;
   q_random(); // perturb it once...
   updateSeed(); // and write it back out - a new seed every battery change.
 
-  // initialize this so it doesn't have to be in the data segment.
-  seed_update_timer = SEED_UPDATE_INTERVAL;
+  // The overrun counters carry across battery changes. Unprogrammed EEPROM
+  // is all ones, which means nothing's been recorded yet.
+  overrun_max = eeprom_read_word(EE_OVERRUN_MAX_LOC);
+  if (overrun_max == 0xffff) overrun_max = 0;
+  overrun_total = eeprom_read_dword(EE_OVERRUN_TOTAL_LOC);
+  if (overrun_total == 0xffffffffL) overrun_total = 0;
 
-  // Set up the initial state of the timer.
-  OCR0A = CLOCK_BASIC_CYCLE + 1;
-  TCNT0 = 0;
+  addTask(dailySave, SEED_UPDATE_INTERVAL, DAILY_SAVE_COST);
+#ifdef STACK_PAINT
+  addTask(updateStack, STACK_CHECK_INTERVAL, STACK_COST);
+#endif
+#ifdef TELEMETRY
+  addTask(sendTelemetry, 0, TELEMETRY_COST);
+#endif
+#ifdef PPS_DISCIPLINE
+  addTask(updatePPS, PPS_UPDATE_INTERVAL, PPS_COST);
+#endif
+
+  // Set up the initial state of the timer. Only start it now. The ADC reads
+  // above take long enough for it to match a top of 0, and that would be a
+  // tenth that never happened.
+#ifdef SWEEP_STEPS
+  OCR0B = SWEEP_PULSE;
+#endif
+  halStart(CLOCK_BASIC_CYCLE + 1);
 
   // Don't forget to turn the interrupts on.
   sei();
@@ -34,7 +34,34 @@ void doSleep();
 // for every call to doTick().
 void doTick();
 
+// Tick 'count' times, 'spacing' ms apart, starting now the way doTick() does.
+// The whole train is timed by the timer, with the CPU asleep in between, and
+// background tasks wait until it's over. It returns at the end of the tenth
+// the last tick ended in, and says how many tenths that was, so the caller
+// can sleep out the rest of its seconds. The spacing is kept between
+// BURST_MIN_SPACING and BURST_MAX_SPACING. Where the timer can't do it (see
+// hal.h), the spacing is rounded to whole tenths.
+#define BURST_MIN_SPACING (60)
+#define BURST_MAX_SPACING (1000)
+unsigned int doTickBurst(unsigned char count, unsigned int spacing);
+
+#ifdef MOVEMENTS
+// With more than one movement (see multi.c), this ticks every movement whose
+// bit is set in the mask, in place of a doSleep(). The pulses go out one at a
+// time, so some may go out in a following tenth instead.
+void doTickMask(unsigned char mask);
+#endif
+
 // random(); is too slow for a 32 kHz system clock. This one uses no
 // higher math - just bit shifts.
 unsigned long q_random();
 
+// Background work. Once it's registered, doSleep() will run the task every
+// 'period' tenths-of-a-second (0 means every time it can), but only when there
+// are more than 'cost' timer counts left before the next interrupt. A timer
+// count is 64 CPU cycles, or about 2 ms, and there are 51 or 52 in a tenth.
+// When there isn't time, the task waits until a doSleep() call that has some,
+// so clock code doesn't have to split its own housekeeping up to keep from
+// working through an interrupt. Tasks run in the order they were added.
+void addTask(void (*task)(), unsigned long period, unsigned char cost);
+
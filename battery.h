@@ -0,0 +1,55 @@
+/*
+
+ Crazy Clock battery monitor
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * VCC is measured by reading the 1.1 volt bandgap with VCC as the reference.
+ * The reading goes *up* as the battery goes down: ADC = 1.1 * 1024 / VCC.
+ *
+ * The thresholds are in millivolts, and can be overridden from the Makefile.
+ * Below BATTERY_LOW_MV, the tick pulses are shortened. Below BATTERY_CRITICAL_MV,
+ * the clock gives up on its personality and just ticks once a second.
+ *
+ * This is kept separate from base.c so that the host model can use it.
+ */
+
+#ifndef BATTERY_LOW_MV
+#define BATTERY_LOW_MV (2400)
+#endif
+#ifndef BATTERY_CRITICAL_MV
+#define BATTERY_CRITICAL_MV (2100)
+#endif
+
+// How often to check, in tenths-of-a-second. 6 hours.
+#define BATTERY_CHECK_INTERVAL (216000L)
+
+// What the ADC will read with the given VCC.
+#define VCC_TO_ADC(mv) ((unsigned int)(1100L * 1024 / (mv)))
+
+#define BATTERY_OK 0
+#define BATTERY_LOW 1
+#define BATTERY_CRITICAL 2
+// base.c moves to this once it has taken over from the clock code.
+#define BATTERY_FALLBACK 3
+
+static inline unsigned char batteryLevel(unsigned int reading) {
+  if (reading >= VCC_TO_ADC(BATTERY_CRITICAL_MV)) return BATTERY_CRITICAL;
+  if (reading >= VCC_TO_ADC(BATTERY_LOW_MV)) return BATTERY_LOW;
+  return BATTERY_OK;
+}
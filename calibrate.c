@@ -22,6 +22,7 @@
  * This is a calibration sketch. It's intended to connect the system clock as directly
  * as possible to an I/O pin. The best we can do is generate a half-speed clock by
  * telling timer0 to toggle OC0A with the system clock. The result is 16.384 kHz.
+ * The tinyAVR 1-series can put the crystal itself out on CLKOUT (PB5), at 32.768 kHz.
  */
 
 #include <avr/io.h>
@@ -30,6 +31,13 @@
 #include <stdlib.h>
 
 void __ATTR_NORETURN__ main() {
+#if defined(__AVR_ATtiny814__) || defined(__AVR_ATtiny1614__) || defined(__AVR_ATtiny3214__)
+  // Everything is off at reset. Start the crystal and run from it, undivided.
+  _PROTECTED_WRITE(CLKCTRL.XOSC32KCTRLA, CLKCTRL_CSUT_16K_gc | CLKCTRL_ENABLE_bm);
+  _PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_XOSC32K_gc | CLKCTRL_CLKOUT_bm);
+  _PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, 0);
+  VPORTB.DIR = _BV(5); // CLKOUT - all unused pins are input
+#else
   ADCSRA = 0; // DIE, ADC!!! DIE!!!
   ACSR = _BV(ACD); // Turn off analog comparator - but was it ever on anyway?
   power_adc_disable();
@@ -50,6 +58,7 @@ void __ATTR_NORETURN__ main() {
   OCR0A = 0; // as fast as possible
   DDRB = _BV(DDB0); // all unused pins are input
   PORTB = 0; // Initialize all pins low.
+#endif
 #endif
 
   // And we're done.
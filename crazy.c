@@ -20,17 +20,27 @@
 
 /*
  * This code will keep a long-term average pulse rate of 1 Hz, but
- * will interleve periods of normal-time, treble-time and third-time ticking.
+ * will interleve periods of ticking at different speeds, in pairs that
+ * net out to normal time.
  *
  */
 
 #include <string.h>
+
+#if defined(UNIT_TEST)
+// On *nix, there is no PROGMEM. Just make it go away and turn the
+// pgm_read operations into just pointer derefs.
+#define PROGMEM
+#define pgm_read_byte(x) *(x)
+#else
+#include <avr/pgmspace.h>
+#endif
+
 #include "base.h"
 
-// These are the values for the randomly constructed instruction list
-#define SLOW_SPEED 1
-#define NORMAL_SPEED 2
-#define FAST_SPEED 3
+// The speeds, as tick patterns, a bit a tenth. Step 2n and 2n + 1 are a pair.
+// See host/steps.py.
+#include "steps.h"
 
 // This *must* be even! It's also a bit of a balancing act between allowing
 // for whackiness, but not allowing the clock to drift too far.
@@ -66,61 +76,31 @@ static unsigned char our_random() {
   return random_buf[--buf_ptr];
 }
 
-static void our_sleep() {
+// This is a background task, so it only runs when there's time left over in a tenth.
+static void refill_random() {
   buf_random();
-  doSleep();
-}
-
-static void our_tick() {
-  //buf_random(); // no - ticking already takes 35 ms.
-  doTick();
 }
-
-// gcc -Os turns these switch statements into data table initialization.
-// That makes a data segment, because AVR-GCC is too stupid to put that
-// constant data into flash. So for these two methods, back down the
-// optimization to O1.
-static void build_list(int which) {
-  int start = 0, end = 0;
-  switch(which) {
-    case 0:
-      start = 0;
-      end = LIST_LENGTH / 2; end -= end % 2; // force it even
-      break;
-    case 1:
-      start = LIST_LENGTH / 2; start -= start % 2;
-      end = LIST_LENGTH;
-      break;
-  }
+#define REFILL_COST (6)
+
+// The list is built and shuffled in halves, so that each half is one run of
+// the rebuild task.
+static void build_list(unsigned char which) {
+  unsigned char start = which ? LIST_LENGTH / 2 : 0;
+  unsigned char end = which ? LIST_LENGTH : LIST_LENGTH / 2;
+  start -= start % 2; end -= end % 2; // force them even
   for(unsigned char i = start; i < end; i += 2) {
-    // We're going to add instructions in pairs - either a double-and-half time pair or a pair of normals.
-    // Adding the half and double speed in pairs - even if they're not done adjacently (as long as they *do* get done)
+    // We're going to add instructions in pairs, whose speeds net out to normal.
+    // Adding them in pairs - even if they're not done adjacently (as long as they *do* get done)
     // will insure the clock will keep long-term time accurately.
-    switch(our_random() % 2) {
-      case 0:
-        instruction_list_stage[i] = SLOW_SPEED;
-        instruction_list_stage[i + 1] = FAST_SPEED;
-        break;
-      case 1:
-        instruction_list_stage[i] = NORMAL_SPEED;
-        instruction_list_stage[i + 1] = NORMAL_SPEED;
-        break;
-    }
+    unsigned char pair = our_random() % SPEED_PAIRS;
+    instruction_list_stage[i] = 2 * pair;
+    instruction_list_stage[i + 1] = 2 * pair + 1;
   }
 }
 
-static void shuffle_list(int which) {
-  int start = 0, end = 0;
-  switch(which) {
-    case 0:
-      start = LIST_LENGTH - 1;
-      end = LIST_LENGTH / 2 - 1;
-      break;
-    case 1:
-      start = LIST_LENGTH / 2 - 1;
-      end = 0;
-      break;
-  }
+static void shuffle_list(unsigned char which) {
+  unsigned char start = which ? LIST_LENGTH / 2 - 1 : LIST_LENGTH - 1;
+  unsigned char end = which ? 0 : LIST_LENGTH / 2 - 1;
   // Now shuffle the array - classic Knuth shuffle
   for(unsigned char i = start; i != end; i--) {
     unsigned char swapspot = our_random() % (i + 1);
@@ -130,13 +110,41 @@ static void shuffle_list(int which) {
   }
 }
 
+// Rebuild the staged instruction list. This is done in phases, one per run of
+// this task, so that none of them blows past an interrupt. Each phase uses up
+// to LIST_LENGTH / 2 random numbers, so it waits until the cache has that many.
+static unsigned char rebuilding_state = 0; // not rebuilding
+
+static void rebuild() {
+  if (rebuilding_state == 0) return;
+  if (buf_ptr < LIST_LENGTH / 2) return;
+  switch(rebuilding_state) {
+    case 1:
+      build_list(0);
+      break;
+    case 2:
+      build_list(1);
+      break;
+    case 3:
+      shuffle_list(0);
+      break;
+    case 4:
+      shuffle_list(1);
+      // all done.
+      rebuilding_state = 0;
+      return;
+  }
+  rebuilding_state++;
+}
+#define REBUILD_COST (14)
+
 void loop() {
   unsigned char instruction_list[LIST_LENGTH];
   unsigned char place_in_list = LIST_LENGTH; // force a reset.
   unsigned char time_per_step = 0; // This is moot - avoids an incorrect warning
   unsigned char time_in_step = 0; // This is also moot - avoids another incorrect warning
-  unsigned char tick_step_placeholder = 0;
-  unsigned char rebuilding_state = 0; // not rebuilding
+  const unsigned char *pattern = steps;
+  unsigned char tenth = 0, bits = 0;
 
   // Fill the random number cache
   while (!buf_random()) ;
@@ -147,81 +155,41 @@ void loop() {
   shuffle_list(0);
   shuffle_list(1);
 
+  addTask(refill_random, 0, REFILL_COST);
+  addTask(rebuild, 0, REBUILD_COST);
+
   // Now we start the clock for real.
   while(1){
-    if (place_in_list >= LIST_LENGTH) {
-      // We're out of instructions. Grab the staged list and set the rebuilding machine in motion.
-      memcpy(instruction_list, instruction_list_stage, sizeof(instruction_list));
-      // This must be a multiple of 3 AND be even!
-      // It also should be long enough to establish a pattern
-      // before changing.
-      time_per_step = ((our_random() % 5) + 2) * 6; // 12 - 36
-      place_in_list = 0;
-      time_in_step = 0;
-      rebuilding_state = 1;
+    if (tenth == 0) {
+      if (place_in_list >= LIST_LENGTH) {
+        // We're out of instructions. Grab the staged list and set the rebuild task in motion.
+        memcpy(instruction_list, instruction_list_stage, sizeof(instruction_list));
+        // This must be a multiple of STEP_SECONDS!
+        // It also should be long enough to establish a pattern
+        // before changing.
+        time_per_step = ((our_random() % 5) + 2) * STEP_SECONDS; // 12 - 36
+        place_in_list = 0;
+        time_in_step = 0;
+        rebuilding_state = 1;
+      }
+      pattern = steps + instruction_list[place_in_list] * STEP_BYTES;
     }
 
-    // Rebuild the staged instruction list. Do this in phases across multiple seconds so that
-    // we don't blow past interrupts.
-    switch(rebuilding_state) {
-      case 0: // not rebuilding
-              break;
-      case 1: // Skip. We just copied the staging list. That alone took enough time.
-              // Also, if this is the very first second, then the random buffer is
-              // empty after the bootstrapping. 9 sleeps should be plenty to replenish
-              // it (since we gain 4 random numbers every time).
-              break;
-      case 2:
-          build_list(0);
-          break;
-      case 3:
-          build_list(1);
-          break;
-      case 4:
-          shuffle_list(0);
-          break;
-      case 5:
-          shuffle_list(1);
-          // all done.
-          rebuilding_state = 0;
-          break;
-    }
-    if (rebuilding_state != 0) rebuilding_state++;
-    
-    // What are we doing right now?
-    // Each case must consume 10 clock ticks - that is,
-    // each must call either our_tick() or our_sleep() a total of 10 times.  
-    switch(instruction_list[place_in_list]) {
-      case SLOW_SPEED:
-        if (tick_step_placeholder == 1) { // Try and stick the lone tick in the middle, sort of
-          our_tick();
-        } else {
-          our_sleep();
-        }
-        for(unsigned char i = 0; i < IRQS_PER_SECOND - 1; i++)
-          our_sleep();
-        break;
-      case NORMAL_SPEED:
-        our_tick();
-        for(unsigned char i = 0; i < IRQS_PER_SECOND - 1; i++)
-          our_sleep();
-        break;
-      case FAST_SPEED:
-        // Tick 5 times over 30 "systicks"
-        for(unsigned char i = 0; i < IRQS_PER_SECOND; i++) {
-          if ((IRQS_PER_SECOND * tick_step_placeholder + i) % 6 == 0) {
-            our_tick();
-          } else {
-            our_sleep();
-          }
-        }
-        break;
-    }
-    ++tick_step_placeholder;
-    tick_step_placeholder %= 3;
-    if (++time_in_step >= time_per_step) {
-      time_in_step = 0;
-      place_in_list++;
+    // What are we doing right now? A bit a tenth, eight to a byte.
+    if ((tenth & 7) == 0) bits = pgm_read_byte(pattern + (tenth >> 3));
+    if (bits & 1)
+      doTick();
+    else
+      doSleep();
+    bits >>= 1;
+
+    if (++tenth >= STEP_TENTHS) {
+      tenth = 0;
+      time_in_step += STEP_SECONDS;
+      if (time_in_step >= time_per_step) {
+        time_in_step = 0;
+        place_in_list++;
+      }
     }
   }
 }
@@ -33,46 +33,23 @@
  * BASE_CYCLE_LENGTH - the whole number portion
  * NUM_LONG_CYCLES - the numerator of the fractional part
  * RUN_SLOW - define this to make the clock run slow, leave it out to run fast
+ *
+ * That's one tenth added or removed every (BASE_CYCLE_LENGTH * CYCLE_COUNT +
+ * NUM_LONG_CYCLES) / CYCLE_COUNT tenths of the clock's own time. rate.h does
+ * the rest, with its units chosen to make that fraction exact: each real
+ * tenth moves the hand on by the fraction's numerator, and a tenth of the
+ * clock's time is that plus or minus the denominator.
  */
 
-#include "base.h"
-
-void loop() {
-  unsigned int inner_counter = 0; // this counts to either BASE_CYCLE or BASE_CYCLE+1 before we adjust tick_counter.
-  unsigned int outer_counter = 0; // this counts inner cycles from 0 to CYCLE_LENGTH
-  unsigned int tick_counter = 0; // This counts SI tenths-of-a-second and we tick the clock when 0. This gets adjusted by the fraction cycles.
-  while(1) {
-      if (++tick_counter >= IRQS_PER_SECOND) {
-        tick_counter = 0;
-      }
-      unsigned int this_cycle_length = BASE_CYCLE_LENGTH;
-      if (outer_counter < NUM_LONG_CYCLES) this_cycle_length++; // If this is a long cycle, increment
-      if (++inner_counter >= this_cycle_length) {
-        inner_counter = 0;
-        // It's time to skip (or add) a sleep.
-        if (++outer_counter >= CYCLE_COUNT) {
-          outer_counter = 0;
-        }
+#define RATE_UNIT (BASE_CYCLE_LENGTH * (long)CYCLE_COUNT + NUM_LONG_CYCLES)
 #ifdef RUN_SLOW
-        // We're inserting, rather than removing sleeps.
-        doSleep();
+#define RATE_SECOND ((RATE_UNIT + CYCLE_COUNT) * IRQS_PER_SECOND)
 #else
-        // we're going to skip a sleep. But we don't
-        // want to skip an actual tick if it's time to do that.
-        // So if it's time to tick then do it, but then skip the next one
-        // by incrementing i an extra time. If not, then just continue the
-        // for loop without the sleep that would follow.
-        if (tick_counter == 0) {
-          doTick();
-          tick_counter++;
-        }
-        continue; // That is, skip the code below.
+#define RATE_SECOND ((RATE_UNIT - CYCLE_COUNT) * IRQS_PER_SECOND)
 #endif
-      }
-      // the inner counter did not roll over. This is an ordinary systick.
-      if (tick_counter == 0)
-        doTick();
-      else
-        doSleep();
-  }
+
+#include "rate.h"
+
+void loop() {
+  while(1) rateTenth();
 }
@@ -26,52 +26,33 @@
  * This clock will be anywhere from on-time to 10 minutes fast... but you
  * won't be able to predict it (without comparing it to a proper clock).
  *
+ * The speed ramps up and down over a few minutes at either end, and rate.h
+ * keeps the books exactly, so the slow part takes back just what the fast
+ * part gained.
  */
 
-#include "base.h"
+#include "rate.h"
 
-// 50 minutes in seconds - at 20% fast, that's 10 minutes error.
-#define FAST_CYCLE_LENGTH (60L*50)
-// This is a multiple of 10% for how much swing we give
-#define FAST_CYCLE_MAGNITUDE (-2)
-#define NORMAL_CYCLE_MAGNITUDE (0)
+// 50 minutes in tenths - at 20% fast, that's 10 minutes gained.
+#define FAST_CYCLE_LENGTH (60L*50*IRQS_PER_SECOND)
+// In millionths, how much swing we give
+#define FAST_CYCLE_RATE (200000L)
 // This is twice as long as the FAST cycle because it's half the error rate
 #define SLOW_CYCLE_LENGTH (FAST_CYCLE_LENGTH * 2)
-#define SLOW_CYCLE_MAGNITUDE -(FAST_CYCLE_MAGNITUDE / 2)
+#define SLOW_CYCLE_RATE -(FAST_CYCLE_RATE / 2)
+
+#if FAST_CYCLE_RATE % RATE_RAMP != 0 || SLOW_CYCLE_RATE % RATE_RAMP != 0
+#error The rates have to be a whole number of ramp steps
+#endif
+#if FAST_CYCLE_RATE * FAST_CYCLE_LENGTH + SLOW_CYCLE_RATE * SLOW_CYCLE_LENGTH != 0
+#error The slow part has to take back exactly what the fast part gained
+#endif
 
 void loop() {
-  // we have a four-state machine. Between each interval of fast or slow
-  // ticking, we put a short period of normal ticking so that the transition
-  // isn't obvious.
-  unsigned char state = 99; // force a reset
-  unsigned long current_cycle_position = 99; // force a reset
-  unsigned long current_cycle_length = 0; // squelch bogus warning
-  char current_cycle_magnitude = 0; // squelch bogus warning
-  while(1) {
-    if (current_cycle_position++ >= current_cycle_length) {
-      if (++state > 3) state = 0;
-      current_cycle_position = 0;
-      switch(state) {
-        case 0:
-        case 2:
-          current_cycle_length = 30 + (q_random() % 30); // shift it around a lot.
-          current_cycle_magnitude = NORMAL_CYCLE_MAGNITUDE;
-          break;
-        case 1:
-          current_cycle_length = FAST_CYCLE_LENGTH;
-          current_cycle_magnitude = FAST_CYCLE_MAGNITUDE;
-          break;
-        case 3:
-          current_cycle_length = SLOW_CYCLE_LENGTH;
-          current_cycle_magnitude = SLOW_CYCLE_MAGNITUDE;
-          break;
-      }
-    }
-    for(unsigned char i = 0; i < IRQS_PER_SECOND + current_cycle_magnitude; i++) {
-      if (i == 0)
-        doTick();
-      else
-        doSleep();
-    }
-  }
-} 
+  // Between each interval of fast or slow ticking, we put a short period of
+  // normal ticking so that the transition isn't obvious.
+  rateRun(0, (30 + (q_random() % 30)) * IRQS_PER_SECOND); // shift it around a lot.
+  rateRun(FAST_CYCLE_RATE, FAST_CYCLE_LENGTH);
+  rateRun(0, (30 + (q_random() % 30)) * IRQS_PER_SECOND);
+  rateRun(SLOW_CYCLE_RATE, SLOW_CYCLE_LENGTH);
+}
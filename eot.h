@@ -0,0 +1,35 @@
+// Generated by host/eot.py - don't edit.
+//
+// Entry n is how much the equation of time changes over day n, in units
+// of EOT_UNIT tenths-of-a-second. Entry 0 is February 11, 2026, when it's
+// -853.4 seconds.
+
+#define EOT_DAYS (365)
+#define EOT_UNIT (5) // half a second
+#define EOT_START_JD (2461082.5) // entry 0, for host/eotcheck.c
+
+static PROGMEM const signed char eot_change[EOT_DAYS] = {
+  0, 2, 3, 5, 6, 8, 9, 11, 11, 14, 14, 16, 17, 18, 19, 21,
+  21, 23, 24, 24, 26, 26, 28, 28, 29, 30, 30, 31, 32, 32, 33, 33,
+  34, 34, 35, 35, 35, 36, 36, 35, 37, 36, 36, 36, 36, 36, 36, 36,
+  36, 35, 36, 35, 34, 34, 34, 34, 33, 32, 32, 31, 31, 30, 30, 28,
+  28, 28, 26, 26, 24, 24, 23, 23, 21, 20, 19, 19, 17, 16, 15, 14,
+  13, 12, 11, 10, 8, 8, 6, 5, 4, 3, 2, 1, -1, -1, -3, -4,
+  -5, -6, -7, -9, -9, -10, -11, -13, -13, -14, -15, -16, -17, -18, -19, -19,
+  -20, -21, -21, -22, -22, -24, -23, -24, -25, -24, -26, -25, -26, -26, -26, -26,
+  -26, -26, -26, -26, -26, -25, -26, -25, -25, -24, -24, -24, -23, -22, -22, -22,
+  -20, -20, -19, -19, -17, -17, -16, -15, -14, -13, -12, -11, -9, -9, -8, -7,
+  -5, -4, -4, -2, 0, 0, 2, 2, 4, 6, 6, 8, 9, 10, 11, 13,
+  13, 15, 16, 17, 19, 19, 21, 21, 23, 24, 25, 26, 27, 28, 29, 29,
+  31, 32, 32, 33, 34, 35, 35, 36, 37, 38, 38, 39, 39, 39, 41, 40,
+  41, 41, 42, 42, 42, 43, 42, 43, 43, 42, 43, 43, 43, 43, 42, 42,
+  43, 41, 42, 41, 41, 40, 40, 40, 39, 38, 38, 37, 36, 36, 34, 34,
+  33, 32, 31, 31, 29, 28, 27, 25, 25, 23, 22, 21, 20, 18, 17, 15,
+  14, 12, 11, 10, 7, 7, 4, 3, 2, 0, -2, -4, -5, -7, -9, -11,
+  -12, -14, -15, -17, -19, -21, -23, -24, -26, -27, -29, -31, -32, -34, -35, -37,
+  -38, -40, -41, -43, -44, -45, -47, -47, -49, -50, -51, -52, -52, -54, -55, -55,
+  -56, -57, -57, -57, -59, -58, -59, -59, -60, -59, -59, -60, -59, -60, -59, -59,
+  -58, -58, -58, -57, -56, -56, -55, -54, -54, -53, -51, -51, -50, -48, -48, -46,
+  -45, -44, -42, -41, -40, -38, -37, -36, -33, -33, -31, -29, -28, -26, -24, -23,
+  -21, -20, -18, -16, -15, -13, -11, -10, -8, -6, -5, -4, -2,
+};
@@ -0,0 +1,78 @@
+/*
+
+ Crazy Clock hardware abstraction
+ Copyright 2014 Nicholas W. Sayer
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * What base.c needs from the chip, and which backend provides it. Either
+ * way, a 32.768 kHz crystal runs the system clock and a timer that
+ * interrupts at the end of every period. base.c strings CLOCK_CYCLES periods
+ * together into tenths, and trims them a timer count at a time.
+ *
+ * hal_timer0.h - ATtiny45 and ATtiny44. Timer0 runs from the system clock,
+ *   so the chip can only idle. All of the build options are here.
+ * hal_rtc.h - ATtiny814, 1614 and 3214. The RTC counts the crystal while
+ *   the rest of the chip is in standby. Only the plain clock, and
+ *   STACK_PAINT, are here so far.
+ *
+ * Each backend defines:
+ *
+ * CLOCK_CYCLES, CLOCK_BASIC_CYCLE, CLOCK_NUM_LONG_CYCLES - the pattern of
+ *   timer periods that adds up to whole tenths, as in base.c.
+ * HAL_TIMER_TOP - the register holding the current period's length, less
+ *   one. The ISR sets the next one in it.
+ * HAL_TIMER_VECT - the timer's interrupt.
+ * HAL_COST_COUNTS - timer counts in each unit of task cost, which is 64
+ *   CPU cycles (see addTask() in base.h).
+ * P0, P1 - the coil pins.
+ *
+ * and these:
+ *
+ * halInit() - everything not in use off, every pin an output and low, the
+ *   system clock set up, the timer's interrupt on and the sleep mode chosen.
+ * halStart(top) - start the timer, with its first period.
+ * halAck() - anything the ISR has to do first.
+ * halCountsLeft() - timer counts left in this period, or 0 if it's over.
+ * halCoilOn(pin), halCoilOff(pin) - drive a coil pin.
+ *
+ * A backend may also have a second compare on the same timer, for
+ * doTickBurst(). Without it, the bursts are made of doTick() and doSleep().
+ *
+ * HAL_MATCH - the compare register, in counts from the start of the period.
+ * HAL_MATCH_VECT - its interrupt.
+ * HAL_COUNT - the counter. Just after the period's interrupt, it may still
+ *   read the old top.
+ * HAL_MS_COUNTS(ms) - milliseconds in timer counts.
+ * halMatchOn(), halMatchOff() - its interrupt on, with no stale match, or off.
+ *
+ * The EEPROM is avr-libc's eeprom_* on either family, and sleeping is its
+ * sleep_mode().
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#if defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny45__)
+#include "hal_timer0.h"
+#elif defined(__AVR_ATtiny814__) || defined(__AVR_ATtiny1614__) || defined(__AVR_ATtiny3214__)
+#include "hal_rtc.h"
+#else
+#error Unsupported chip
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+/*
+
+ Crazy Clock tinyAVR 1-series backend
+ Copyright 2014 Nicholas W. Sayer
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The ATtiny814, 1614 and 3214, with a 32.768 kHz crystal on TOSC1 and TOSC2
+ * (PB3 and PB2). See hal.h. Only the 1-series has the crystal oscillator -
+ * the 0-series would need an external 32 kHz clock.
+ *
+ * The crystal is the main clock, undivided, so the code runs just as it does
+ * on the ATtiny45, and it also clocks the RTC. The RTC's period interrupt
+ * (the PIT) keeps running in power-down, but it can only divide by powers of
+ * two, and a tenth is 3276.8 crystal cycles. So the RTC's own counter makes
+ * the tenths, the same way Timer0 does, and the chip sleeps in standby. With
+ * nothing else running there, that's the same 1 uA or so as power-down, and
+ * far below the ATtiny45's idle sleep.
+ *
+ * Programming is over UPDI (PA0). The clock source is set here rather than
+ * in the fuses.
+ */
+
+#ifndef HAL_RTC_H
+#define HAL_RTC_H
+
+#if defined(TEMP_COMP) || defined(BATTERY_MONITOR) || defined(TELEMETRY) || defined(SWEEP_STEPS) || \
+    defined(PPS_DISCIPLINE) || defined(BEMF_SENSE) || defined(MOVEMENTS)
+#error Only STACK_PAINT has been brought over to the tinyAVR 1-series so far
+#endif
+
+// 32,768 divided by 10 is 3276 4/5, which is 3277*4 + 3276. The RTC counts
+// from 0 to PER inclusive, so that's one less.
+#define CLOCK_CYCLES (5)
+#define CLOCK_BASIC_CYCLE (3276 - 1)
+#define CLOCK_NUM_LONG_CYCLES (4)
+
+#define HAL_TIMER_TOP RTC.PER
+#define HAL_TIMER_VECT RTC_CNT_vect
+// The RTC counts single crystal cycles.
+#define HAL_COST_COUNTS (64)
+
+// clock solenoid pins
+#define P0 (2) // PA2
+#define P1 (3) // PA3
+
+static inline void halInit() {
+  // Everything else is off until it's turned on. To minimize power
+  // consumption, all pins but the crystal's are outputs, and low. PA0 is
+  // UPDI.
+  VPORTA.DIR = 0xff;
+  VPORTA.OUT = 0;
+  VPORTB.DIR = _BV(0) | _BV(1);
+  VPORTB.OUT = 0;
+
+  // Start the crystal, and move over to it from the 20 MHz oscillator and
+  // its divide by 6. The switch waits for the crystal to start.
+  _PROTECTED_WRITE(CLKCTRL.XOSC32KCTRLA, CLKCTRL_CSUT_16K_gc | CLKCTRL_ENABLE_bm);
+  _PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_XOSC32K_gc);
+  while(CLKCTRL.MCLKSTATUS & CLKCTRL_SOSC_bm) ;
+  _PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, 0);
+
+  while(RTC.STATUS) ; // any earlier writes have to get across to the RTC first
+  RTC.CLKSEL = RTC_CLKSEL_TOSC32K_gc;
+  RTC.INTCTRL = RTC_OVF_bm;
+
+  set_sleep_mode(SLEEP_MODE_STANDBY);
+}
+
+static inline void halStart(unsigned int top) {
+  while(RTC.STATUS) ;
+  RTC.PER = top;
+  RTC.CNT = 0;
+  RTC.CTRLA = RTC_PRESCALER_DIV1_gc | RTC_RUNSTDBY_bm | RTC_RTCEN_bm;
+}
+
+// Unlike Timer0's, the overflow flag has to be cleared by hand. PER is
+// written in the RTC's own clock, a couple of cycles later. The last one
+// was a tenth ago, but a new one mustn't start before it's done.
+static inline void halAck() {
+  RTC.INTFLAGS = RTC_OVF_bm;
+  while(RTC.STATUS & RTC_PERBUSY_bm) ;
+}
+
+// The flag is set as the counter goes from PER back to 0.
+static inline unsigned int halCountsLeft() {
+  unsigned int now = RTC.CNT, top = RTC.PER;
+  if (RTC.INTFLAGS & RTC_OVF_bm)
+    return 0;
+  else
+    return top - now + 1;
+}
+
+// These are single instructions on the virtual port.
+static inline void halCoilOn(unsigned char pin) {
+  VPORTA.OUT |= _BV(pin);
+}
+
+static inline void halCoilOff(unsigned char pin) {
+  VPORTA.OUT &= ~_BV(pin);
+}
+
+#endif
@@ -0,0 +1,180 @@
+/*
+
+ Crazy Clock ATtiny45/44 backend
+ Copyright 2014 Nicholas W. Sayer
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The ATtiny45 and ATtiny44, fused to run from the 32.768 kHz crystal. See
+ * hal.h. Timer0 counts system clocks, so while it runs, the chip can do no
+ * better than idle sleep.
+ */
+
+#ifndef HAL_TIMER0_H
+#define HAL_TIMER0_H
+
+#ifdef SWEEP_STEPS
+// A sweep movement takes SWEEP_STEPS short steps a second. The timer runs
+// with a prescale of 8 - 4096 counts a second - and interrupts several times
+// a tenth. Those "sub-ticks" are SUBTICKS_PER_STEP to a step, so the steps
+// come out evenly spaced. Only the last sub-tick of a tenth counts for doSleep().
+#define TIMER_PRESCALE (_BV(CS01)) // prescale = 8
+#define SUBTICKS_PER_STEP (5)
+#if SWEEP_STEPS == 8
+// 40 Hz. 4,096 divided by 40 is 102 2/5, which is 103*2 + 102*3
+#define SUBTICKS_PER_TENTH (4)
+#define CLOCK_CYCLES (5)
+#define CLOCK_BASIC_CYCLE (102 - 1)
+#define CLOCK_NUM_LONG_CYCLES (2)
+#elif SWEEP_STEPS == 16
+// 80 Hz. 4,096 divided by 80 is 51 1/5, just like the normal 10 Hz.
+#define SUBTICKS_PER_TENTH (8)
+#define CLOCK_CYCLES (5)
+#define CLOCK_BASIC_CYCLE (51 - 1)
+#define CLOCK_NUM_LONG_CYCLES (1)
+#else
+#error SWEEP_STEPS must be 8 or 16
+#endif
+#define SUBTICKS_PER_SECOND (SUBTICKS_PER_TENTH * IRQS_PER_SECOND)
+// How long each step pulse is, in timer counts of 8 cycles (244 us). The
+// pulse is started by the sub-tick interrupt and ended by compare B, so it
+// has to end before the next sub-tick.
+#ifndef SWEEP_PULSE
+#define SWEEP_PULSE (24)
+#endif
+#if SWEEP_PULSE >= CLOCK_BASIC_CYCLE
+#error SWEEP_PULSE is too long
+#endif
+#if defined(MOVEMENTS)
+#error SWEEP_STEPS and MOVEMENTS cannot be used together
+#endif
+#else
+#define TIMER_PRESCALE (_BV(CS01) | _BV(CS00)) // prescale = 64
+// 32,768 divided by (64 * 10) yields a divisor of 51 1/5, which is 52 + 51*4
+#define CLOCK_CYCLES (5)
+// Don't forget to decrement the OCR0A value - it's 0 based and inclusive
+#define CLOCK_BASIC_CYCLE (51 - 1)
+// a "long" cycle is CLOCK_BASIC_CYCLE + 1
+#define CLOCK_NUM_LONG_CYCLES (1)
+#endif
+
+#define HAL_TIMER_TOP OCR0A
+#define HAL_TIMER_VECT TIM0_COMPA_vect
+// The timer counts are the cost units, without SWEEP_STEPS. See haveTime().
+#define HAL_COST_COUNTS (1)
+
+#ifndef SWEEP_STEPS
+// Compare B, for events partway through a period. The sweep drive has it.
+#define HAL_MATCH OCR0B
+#define HAL_MATCH_VECT TIM0_COMPB_vect
+#define HAL_COUNT TCNT0
+// Milliseconds in timer counts of 64 cycles, to the nearest count. Up to 1000.
+#define HAL_MS_COUNTS(ms) (((ms) * 64U + 62) / 125)
+#endif
+
+// clock solenoid pins
+#ifdef __AVR_ATtiny44__
+#define CLOCK_PORT PORTA
+#define P0 PORTA5
+#define P1 PORTA6
+#define CLOCK_DDR DDRA
+// To minimize power consumption all pins must be output.
+#define CLOCK_DDR_BITS (_BV(DDA0) | _BV(DDA1) | _BV(DDA2) | _BV(DDA3) | _BV(DDA4) | _BV(DDA5) | _BV(DDA6) | _BV(DDA7))
+#define EXTRA_DDR DDRB
+#ifdef PPS_DISCIPLINE
+#define EXTRA_DDR_BITS (0) // PB2 is the reference input
+#else
+#define EXTRA_DDR_BITS (_BV(DDB2))
+#endif
+#define TIMER_FLAGS TIFR0
+#define TIMER_MASK TIMSK0
+#else
+#define CLOCK_PORT PORTB
+#define P0 PORTB0
+#define P1 PORTB1
+#define CLOCK_DDR DDRB
+// To minimize power consumption all pins must be output.
+#ifdef PPS_DISCIPLINE
+#define CLOCK_DDR_BITS (_BV(DDB0) | _BV(DDB1)) // PB2 is the reference input
+#else
+#define CLOCK_DDR_BITS (_BV(DDB0) | _BV(DDB1) | _BV(DDB2))
+#endif
+#define TIMER_FLAGS TIFR
+#define TIMER_MASK TIMSK
+#endif
+
+static inline void halInit() {
+  ADCSRA = 0; // DIE, ADC!!! DIE!!!
+  ACSR = _BV(ACD); // Turn off analog comparator - but was it ever on anyway?
+  power_adc_disable();
+  power_usi_disable();
+  power_timer1_disable();
+  TCCR0A = _BV(WGM01); // mode 2 - CTC
+  TIMER_MASK = _BV(OCIE0A); // OCR0A interrupt only.
+
+  set_sleep_mode(SLEEP_MODE_IDLE);
+
+  CLOCK_DDR = CLOCK_DDR_BITS;
+#ifdef __AVR_ATtiny44__
+  EXTRA_DDR = EXTRA_DDR_BITS;
+#endif
+  CLOCK_PORT = 0; // Initialize all pins low.
+}
+
+static inline void halStart(unsigned char top) {
+  OCR0A = top;
+  TCNT0 = 0;
+  TCCR0B = TIMER_PRESCALE;
+}
+
+// The compare flag clears itself.
+static inline void halAck() { }
+
+// The counter doesn't reset until one timer count after the compare, so
+// just after the ISR it still reads the old top - which may be at, or past,
+// the new one.
+static inline unsigned int halCountsLeft() {
+  unsigned char now = TCNT0, top = OCR0A;
+  if (TIMER_FLAGS & _BV(OCF0A))
+    return 0;
+  else if (now >= top)
+    return top + 1;
+  else
+    return top - now;
+}
+
+#ifdef HAL_MATCH
+// It may have matched earlier in the period.
+static inline void halMatchOn() {
+  TIMER_FLAGS = _BV(OCF0B);
+  TIMER_MASK |= _BV(OCIE0B);
+}
+
+static inline void halMatchOff() {
+  TIMER_MASK &= ~_BV(OCIE0B);
+}
+#endif
+
+static inline void halCoilOn(unsigned char pin) {
+  CLOCK_PORT |= _BV(pin);
+}
+
+static inline void halCoilOff(unsigned char pin) {
+  CLOCK_PORT &= ~_BV(pin);
+}
+
+#endif
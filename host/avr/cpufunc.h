@@ -0,0 +1,7 @@
+// Host shim for <avr/cpufunc.h>. See hostsim.h.
+#ifndef HOST_AVR_CPUFUNC_H
+#define HOST_AVR_CPUFUNC_H
+
+#define _NOP()
+
+#endif
@@ -0,0 +1,12 @@
+// Host shim for <avr/interrupt.h>. See hostsim.h.
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+void host_sei(void);
+void host_cli(void);
+
+#define sei() host_sei()
+#define cli() host_cli()
+#define ISR(vector) void vector(void)
+
+#endif
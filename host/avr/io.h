@@ -0,0 +1,144 @@
+// Host shim for <avr/io.h>. See hostsim.h.
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+#define __ATTR_NORETURN__ __attribute__((__noreturn__))
+
+extern volatile uint8_t PORTA, DDRA, PORTB, DDRB;
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK, TIMSK0;
+extern volatile uint8_t ADMUX, DIDR0;
+// INT0 only sees rising edges from host_int0. See hostsim.h.
+extern volatile uint8_t MCUCR, GIMSK;
+// There's no AVR stack here. STACK_PAINT compiles, but finds nothing to paint.
+extern volatile uint16_t SP;
+#define RAMEND (0x15f)
+extern volatile uint16_t ADC;
+
+// Starting a conversion on ADCSRA finishes it the next time it's touched.
+volatile uint8_t *host_adcsra(void);
+#define ADCSRA (*host_adcsra())
+
+// ACO follows host_comparator whenever ACSR is read with the comparator on.
+volatile uint8_t *host_acsr(void);
+#define ACSR (*host_acsr())
+
+// TCNT0 is computed from the cycle count whenever it's touched.
+volatile uint8_t *host_tcnt0(void);
+#define TCNT0 (*host_tcnt0())
+
+// Only the compare A flag is there, and it's read-only. The ISR clears it.
+volatile uint8_t *host_tifr(void);
+#define TIFR (*host_tifr())
+#define TIFR0 (*host_tifr())
+
+#define PORTA0 0
+#define PORTA1 1
+#define PORTA2 2
+#define PORTA3 3
+#define PORTA4 4
+#define PORTA5 5
+#define PORTA6 6
+#define PORTA7 7
+#define DDA0 0
+#define DDA1 1
+#define DDA2 2
+#define DDA3 3
+#define DDA4 4
+#define DDA5 5
+#define DDA6 6
+#define DDA7 7
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+
+#define WGM00 0
+#define WGM01 1
+#define COM0A0 6
+#define COM0A1 7
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define OCIE0A 4
+#define OCIE0B 3
+#define OCF0A 4
+#define OCF0B 3
+#define TOIE0 1
+
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define MUX4 4
+#define MUX5 5
+#define REFS0 6
+#define REFS1 7
+#define REFS2 4
+#define ISC00 0
+#define ISC01 1
+#define INT0 6
+#define ACO 5
+#define ACD 7
+#define AIN0D 0
+#define AIN1D 1
+
+
+#if defined(__AVR_ATtiny814__) || defined(__AVR_ATtiny1614__) || defined(__AVR_ATtiny3214__)
+// The tinyAVR 1-series parts in hal_rtc.h. The ATtiny45's registers above
+// are still there, unused.
+#define HOST_RTC
+typedef struct {
+  volatile uint8_t DIR, OUT, IN, INTFLAGS;
+} VPORT_t;
+extern VPORT_t VPORTA, VPORTB;
+// Only what's used. The simulator stops if the main clock isn't the crystal,
+// undivided, when the clock first sleeps.
+typedef struct {
+  volatile uint8_t MCLKCTRLA, MCLKCTRLB, MCLKSTATUS, XOSC32KCTRLA;
+} CLKCTRL_t;
+extern CLKCTRL_t CLKCTRL;
+// There's no configuration change protection here.
+#define _PROTECTED_WRITE(reg, value) ((reg) = (value))
+// CNT and INTFLAGS are brought up to date whenever RTC is touched. Writes
+// take effect straight away, so STATUS always reads 0. The ISR has to clear
+// the overflow flag itself, or the simulator stops.
+typedef struct {
+  volatile uint8_t CTRLA, STATUS, INTCTRL, INTFLAGS, CLKSEL;
+  volatile uint16_t CNT, PER;
+} RTC_t;
+RTC_t *host_rtc(void);
+#define RTC (*host_rtc())
+#define CLKCTRL_CLKSEL_XOSC32K_gc (0x02)
+#define CLKCTRL_PEN_bm (0x01)
+#define CLKCTRL_PDIV_6X_gc (0x08 << 1)
+#define CLKCTRL_SOSC_bm (0x01)
+#define CLKCTRL_ENABLE_bm (0x01)
+#define CLKCTRL_CSUT_16K_gc (0x02 << 4)
+#define RTC_RTCEN_bm (0x01)
+#define RTC_PRESCALER_DIV1_gc (0x00 << 3)
+#define RTC_RUNSTDBY_bm (0x80)
+#define RTC_PERBUSY_bm (0x04)
+#define RTC_OVF_bm (0x01)
+#define RTC_CLKSEL_TOSC32K_gc (0x02)
+#endif
+
+#endif
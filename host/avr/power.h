@@ -0,0 +1,11 @@
+// Host shim for <avr/power.h>. See hostsim.h.
+#ifndef HOST_AVR_POWER_H
+#define HOST_AVR_POWER_H
+
+#define power_adc_enable()
+#define power_adc_disable()
+#define power_usi_disable()
+#define power_timer0_disable()
+#define power_timer1_disable()
+
+#endif
@@ -0,0 +1,20 @@
+// Host shim for <avr/sleep.h>. See hostsim.h.
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC 1
+#define SLEEP_MODE_PWR_DOWN 2
+#define SLEEP_MODE_STANDBY 3
+
+// The simulator stops if the timer wouldn't run in the chosen mode.
+extern uint8_t host_sleep_mode;
+
+void host_sleep(void);
+
+#define set_sleep_mode(mode) (host_sleep_mode = (mode))
+#define sleep_mode() host_sleep()
+
+#endif
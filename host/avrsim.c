@@ -0,0 +1,351 @@
+/*
+
+ Crazy Clock simavr runner
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs a built firmware image under simavr, headless, and watches the
+ * clock coil pins. Sleeping is fast-forwarded, so a simulated day takes a
+ * few seconds. It checks that every pulse is the right width and that the
+ * polarity alternates, and writes out a tick trace - one line per tick with
+ * the tenth-of-a-second it started in and which coil pin it was. hosttrace.c
+ * writes the same trace from the host simulator, so comparing the two checks
+ * the real image against the host model.
+ *
+ * With -p, it also profiles every wake: the CPU cycles from the interrupt
+ * that wakes the clock to the next sleep. The clock code has to be done well
+ * inside the 3277 cycles between interrupts. The profile is printed at the
+ * end - percentiles, the worst case and where that worst wake spent its
+ * cycles. The symbol file is the output of 'avr-nm -n'.
+ *
+ * With -u, it also listens to a TELEMETRY build's serial line on PB2 and
+ * writes the bytes it gets to the given file, for teledecode. It samples the
+ * middle of each bit, at the real bit time, so it checks base.c's bit timing
+ * too.
+ *
+ * With -r, it also watches the stack pointer after every instruction, and
+ * says how deep the stack ever got. A STACK_PAINT build keeps its own
+ * figure in EEPROM - the least room it's ever had to spare above .bss - and
+ * that's printed too, since the two should agree.
+ *
+ * usage: avrsim [-m mcu] [-d days] [-s seed] [-w width_ms] [-p symbols] [-u file] [-r] file.elf
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_ioport.h"
+#include "avr_eeprom.h"
+
+#define CRYSTAL (32768)
+#define CYCLES_PER_TENTH (CRYSTAL / 10.0)
+// Every wake longer than this lands in the last bucket.
+#define MAX_WAKE (65536)
+#define MAX_SYMBOLS (512)
+// See telemetry.h.
+#define UART_BIT (CRYSTAL / 300.0)
+// See STACK_PAINT in base.c.
+#define EE_STACK_LOC (16)
+
+struct coil {
+  avr_t *avr;
+  int pin; // 0 or 1
+  avr_cycle_count_t rise;
+};
+
+static uint8_t last_pin = 0xff;
+static unsigned long ticks;
+static int errors;
+static double width_ms = 30;
+static double days = 1;
+
+struct symbol {
+  uint32_t addr;
+  char name[64];
+};
+static struct symbol symbols[MAX_SYMBOLS];
+static int symbol_count;
+
+static unsigned long wake_histogram[MAX_WAKE + 1];
+static unsigned long wakes;
+// Cycles per symbol in this wake, and in the worst one so far.
+static uint32_t wake_cycles[MAX_SYMBOLS + 1];
+static uint32_t worst_cycles[MAX_SYMBOLS + 1];
+static avr_cycle_count_t worst, worst_at;
+
+// Reads the text symbols out of 'avr-nm -n' output. They're sorted.
+static int readSymbols(const char *file) {
+  FILE *f = fopen(file, "r");
+  if (!f) return -1;
+  char line[128], type, name[64];
+  unsigned long addr;
+  while(fgets(line, sizeof(line), f) && symbol_count < MAX_SYMBOLS) {
+    if (sscanf(line, "%lx %c %63s", &addr, &type, name) != 3) continue;
+    if (type != 'T' && type != 't') continue;
+    symbols[symbol_count].addr = addr;
+    strcpy(symbols[symbol_count].name, name);
+    symbol_count++;
+  }
+  fclose(f);
+  return 0;
+}
+
+// The symbol containing the given address, or symbol_count if there's none.
+static int findSymbol(uint32_t pc) {
+  int lo = 0, hi = symbol_count;
+  while(lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (symbols[mid].addr <= pc) lo = mid + 1; else hi = mid;
+  }
+  return lo == 0 ? symbol_count : lo - 1;
+}
+
+static void endWake(avr_cycle_count_t start, avr_cycle_count_t end) {
+  avr_cycle_count_t active = end - start;
+  wake_histogram[active > MAX_WAKE ? MAX_WAKE : active]++;
+  wakes++;
+  if (active > worst) {
+    worst = active;
+    worst_at = start;
+    memcpy(worst_cycles, wake_cycles, sizeof(worst_cycles));
+  }
+  memset(wake_cycles, 0, sizeof(wake_cycles));
+}
+
+static unsigned long percentile(double p) {
+  unsigned long want = (unsigned long)(wakes * p), seen = 0;
+  for(unsigned long i = 0; i <= MAX_WAKE; i++) {
+    seen += wake_histogram[i];
+    if (seen > want) return i;
+  }
+  return MAX_WAKE;
+}
+
+static void report(const char *name) {
+  if (!wakes) {
+    fprintf(stderr, "%s: the clock never slept\n", name);
+    return;
+  }
+  fprintf(stderr, "%s: %lu wakes, cycles awake: 50%% %lu, 90%% %lu, 99%% %lu, 99.9%% %lu, worst %llu (%.0f%% of a tenth) at tenth %lu\n",
+    name, wakes, percentile(.5), percentile(.9), percentile(.99), percentile(.999),
+    (unsigned long long)worst, worst * 100 / CYCLES_PER_TENTH, (unsigned long)(worst_at / CYCLES_PER_TENTH));
+  for(int i = 0; i <= symbol_count; i++) {
+    if (!worst_cycles[i]) continue;
+    fprintf(stderr, "  %6lu %s\n", (unsigned long)worst_cycles[i], i < symbol_count ? symbols[i].name : "?");
+  }
+}
+
+// A receiver for the serial line. Between edges the level doesn't change, so
+// each edge first samples every bit middle that went by since the last one.
+struct uart {
+  avr_t *avr;
+  FILE *out;
+  int level;
+  int bit; // the next one to sample, 0 for the start bit, or -1 when idle
+  unsigned char byte;
+  avr_cycle_count_t start;
+  unsigned long bytes, framing;
+};
+
+static void uartCatchUp(struct uart *u, avr_cycle_count_t now) {
+  while(u->bit >= 0 && u->start + (avr_cycle_count_t)(UART_BIT * (u->bit + 0.5)) < now) {
+    if (u->bit == 0) {
+      if (u->level) u->bit = -1; // only a glitch
+      else u->bit++;
+    } else if (u->bit <= 8) {
+      if (u->level) u->byte |= 1 << (u->bit - 1);
+      u->bit++;
+    } else {
+      if (!u->level) u->framing++;
+      fputc(u->byte, u->out);
+      u->bytes++;
+      u->bit = -1;
+    }
+  }
+}
+
+static void uartChanged(struct avr_irq_t *irq, uint32_t value, void *param) {
+  struct uart *u = param;
+  uartCatchUp(u, u->avr->cycle);
+  u->level = value;
+  if (!value && u->bit < 0) {
+    u->start = u->avr->cycle;
+    u->byte = 0;
+    u->bit = 0;
+  }
+}
+
+static void pinChanged(struct avr_irq_t *irq, uint32_t value, void *param) {
+  struct coil *c = param;
+  if (value) {
+    c->rise = c->avr->cycle;
+    return;
+  }
+  double ms = (c->avr->cycle - c->rise) * 1000.0 / CRYSTAL;
+  unsigned long tenth = (unsigned long)(c->rise / CYCLES_PER_TENTH + 0.5);
+  if (ms < width_ms * 0.95 || ms > width_ms * 1.05) {
+    fprintf(stderr, "tenth %lu: pulse was %.2f ms\n", tenth, ms);
+    errors++;
+  }
+  if (c->pin == last_pin) {
+    fprintf(stderr, "tenth %lu: same polarity twice\n", tenth);
+    errors++;
+  }
+  last_pin = c->pin;
+  ticks++;
+  printf("%lu %d\n", tenth, c->pin);
+}
+
+int main(int argc, char **argv) {
+  const char *mmcu = "attiny45";
+  uint32_t seed = 0x12345678;
+  int profile = 0, stack = 0;
+  struct uart uart = { .level = 1, .bit = -1 };
+  int opt;
+  while((opt = getopt(argc, argv, "m:d:s:w:p:u:r")) != -1) {
+    switch(opt) {
+      case 'm': mmcu = optarg; break;
+      case 'd': days = atof(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      case 'w': width_ms = atof(optarg); break;
+      case 'p':
+        if (readSymbols(optarg)) {
+          perror(optarg);
+          return 2;
+        }
+        profile = 1;
+        break;
+      case 'u':
+        if (!(uart.out = fopen(optarg, "wb"))) {
+          perror(optarg);
+          return 2;
+        }
+        break;
+      case 'r': stack = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-m mcu] [-d days] [-s seed] [-w width_ms] [-p symbols] [-u file] [-r] file.elf\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "no firmware given\n");
+    return 2;
+  }
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(argv[optind], &firmware) != 0) {
+    fprintf(stderr, "can't read %s\n", argv[optind]);
+    return 2;
+  }
+  strncpy(firmware.mmcu, mmcu, sizeof(firmware.mmcu) - 1);
+  firmware.frequency = CRYSTAL;
+
+  avr_t *avr = avr_make_mcu_by_name(firmware.mmcu);
+  if (!avr) {
+    fprintf(stderr, "simavr doesn't know %s\n", firmware.mmcu);
+    return 2;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+
+  // A known seed, and no trim. The rest of the EEPROM is erased.
+  uint8_t ee[18];
+  memset(ee, 0xff, sizeof(ee));
+  memcpy(ee, &seed, sizeof(seed));
+  ee[4] = ee[5] = 0;
+  avr_eeprom_desc_t desc = { .ee = ee, .offset = 0, .size = sizeof(ee) };
+  avr_ioctl(avr, AVR_IOCTL_EEPROM_SET, &desc);
+
+  // The coil pins. See base.c.
+  char port = 'B';
+  int pins[2] = { 0, 1 };
+  if (strcmp(mmcu, "attiny44") == 0) {
+    port = 'A';
+    pins[0] = 5;
+    pins[1] = 6;
+  }
+  struct coil coils[2];
+  for(int i = 0; i < 2; i++) {
+    coils[i].avr = avr;
+    coils[i].pin = i;
+    coils[i].rise = 0;
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(port), pins[i]), pinChanged, &coils[i]);
+  }
+  if (uart.out) {
+    uart.avr = avr;
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 2), uartChanged, &uart);
+  }
+
+  avr_cycle_count_t limit = (avr_cycle_count_t)(days * 86400 * CRYSTAL);
+  // Startup isn't a wake - it has no deadline.
+  int started = 0;
+  avr_cycle_count_t wake = 0;
+  uint16_t lowest_sp = avr->ramend;
+  while(avr->cycle < limit) {
+    int was_sleeping = avr->state == cpu_Sleeping;
+    uint32_t pc = avr->pc;
+    avr_cycle_count_t before = avr->cycle;
+    int state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+      fprintf(stderr, "the CPU stopped at cycle %llu\n", (unsigned long long)avr->cycle);
+      errors++;
+      break;
+    }
+    if (stack) {
+      uint16_t sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+      if (sp < lowest_sp) lowest_sp = sp;
+    }
+    if (!profile) continue;
+    if (was_sleeping) {
+      // That run skipped ahead to the interrupt.
+      if (state != cpu_Sleeping) wake = avr->cycle;
+      continue;
+    }
+    wake_cycles[findSymbol(pc)] += avr->cycle - before;
+    if (state == cpu_Sleeping) {
+      if (started)
+        endWake(wake, avr->cycle);
+      else
+        memset(wake_cycles, 0, sizeof(wake_cycles));
+      started = 1;
+    }
+  }
+  fprintf(stderr, "%s: %lu ticks in %g days, %.1f per day\n", argv[optind], ticks, days, ticks / days);
+  if (profile) report(argv[optind]);
+  if (stack) {
+    fprintf(stderr, "%s: deepest stack %u bytes, lowest SP 0x%04x\n", argv[optind], avr->ramend - lowest_sp,
+      lowest_sp);
+    avr_eeprom_desc_t got = { .offset = EE_STACK_LOC, .size = 2 };
+    avr_ioctl(avr, AVR_IOCTL_EEPROM_GET, &got);
+    unsigned int headroom = got.ee[0] | (got.ee[1] << 8);
+    if (headroom != 0xffff)
+      fprintf(stderr, "%s: STACK_PAINT says %u bytes were never touched\n", argv[optind], headroom);
+  }
+  if (uart.out) {
+    uartCatchUp(&uart, avr->cycle);
+    fclose(uart.out);
+    fprintf(stderr, "%s: %lu serial bytes, %lu framing errors\n", argv[optind], uart.bytes, uart.framing);
+    if (uart.framing) errors++;
+  }
+  return errors ? 1 : 0;
+}
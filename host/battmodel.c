@@ -0,0 +1,140 @@
+/*
+
+ Crazy Clock battery model
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs the battery.h thresholds against a simulated discharge of a pair
+ * of alkaline cells. The ADC reading is quantized the way the chip does it
+ * and checked on the same 6 hour schedule. The clock is dead when either the
+ * controller browns out or the tick pulse doesn't carry enough energy to move
+ * the movement.
+ *
+ * It prints the battery life with and without the low power modes, and fails
+ * if the thresholds are out of order or the low power modes don't help.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "battery.h"
+
+// Two alkaline cells in series, 2500 mAh.
+#define CAPACITY (2500.0 * 3600 / 1000) // coulombs
+#define CELLS (2)
+
+// Per-cell voltage as a function of the fraction of capacity used.
+static const double curve[][2] = {
+  { 0.0, 1.60 }, { 0.1, 1.45 }, { 0.5, 1.25 }, { 0.8, 1.10 }, { 0.9, 1.00 }, { 1.0, 0.80 },
+};
+
+// The controller's minimum VCC.
+#define BROWN_OUT (1.8)
+
+// The coil (plus series resistor) and the movement. The movement stops
+// stepping when V^2 / R * t drops below what a full pulse delivers at
+// STALL_VOLTS.
+#define COIL_OHMS (1000.0)
+#define STALL_VOLTS (1.2)
+#define TICK_LENGTH (30)
+#ifndef TICK_LENGTH_LOW
+#define TICK_LENGTH_LOW (20)
+#endif
+
+// Idle current, and the extra current when the CPU is running. The random
+// clocks spend a lot more time awake than a plain one.
+#define IDLE_AMPS (60e-6)
+#define ACTIVE_AMPS (40e-6)
+#define RANDOM_DUTY (0.15)
+#define PLAIN_DUTY (0.02)
+
+#define STEP (3600.0) // seconds
+
+static double volts(double used) {
+  double fraction = used / CAPACITY;
+  for(unsigned int i = 1; i < sizeof(curve) / sizeof(curve[0]); i++) {
+    if (fraction <= curve[i][0]) {
+      double f = (fraction - curve[i - 1][0]) / (curve[i][0] - curve[i - 1][0]);
+      return CELLS * (curve[i - 1][1] + f * (curve[i][1] - curve[i - 1][1]));
+    }
+  }
+  return CELLS * curve[sizeof(curve) / sizeof(curve[0]) - 1][1];
+}
+
+// What the chip would read. The ADC truncates.
+static unsigned int reading(double vcc) {
+  unsigned int r = (unsigned int)(1.1 * 1024 / vcc);
+  return r > 1023 ? 1023 : r;
+}
+
+// Returns the battery life in days. Prints the days spent at each level.
+static double simulate(int monitor) {
+  double used = 0;
+  unsigned char level = BATTERY_OK;
+  double at_level[3] = { 0, 0, 0 };
+  double check = 0;
+  double stall_energy = STALL_VOLTS * STALL_VOLTS / COIL_OHMS * TICK_LENGTH / 1000;
+  for(double t = 0; ; t += STEP) {
+    double vcc = volts(used);
+    if (monitor && t >= check) {
+      unsigned char l = batteryLevel(reading(vcc));
+      if (l > level) level = l;
+      check += BATTERY_CHECK_INTERVAL / 10;
+    }
+    double pulse = (level == BATTERY_OK ? TICK_LENGTH : TICK_LENGTH_LOW) / 1000.0;
+    if (vcc < BROWN_OUT || vcc * vcc / COIL_OHMS * pulse < stall_energy) {
+      if (monitor)
+        printf("  ok %.0f days, low %.0f days, critical %.0f days, dead at %.2f V\n",
+          at_level[0] / 86400, at_level[1] / 86400, at_level[2] / 86400, vcc);
+      return t / 86400;
+    }
+    double duty = (level == BATTERY_CRITICAL) ? PLAIN_DUTY : RANDOM_DUTY;
+    double amps = IDLE_AMPS + ACTIVE_AMPS * duty + vcc / COIL_OHMS * pulse; // one pulse a second
+    used += amps * STEP;
+    at_level[level] += STEP;
+  }
+}
+
+int main() {
+  int failed = 0;
+
+  // The thresholds have to make sense, and the quantized readings have to
+  // land on the right side of them.
+  if (BATTERY_CRITICAL_MV >= BATTERY_LOW_MV) {
+    printf("FAIL: BATTERY_CRITICAL_MV must be below BATTERY_LOW_MV\n");
+    failed = 1;
+  }
+  if (batteryLevel(reading((BATTERY_LOW_MV + 20) / 1000.0)) != BATTERY_OK ||
+      batteryLevel(reading((BATTERY_LOW_MV - 20) / 1000.0)) != BATTERY_LOW ||
+      batteryLevel(reading((BATTERY_CRITICAL_MV - 20) / 1000.0)) != BATTERY_CRITICAL) {
+    printf("FAIL: ADC readings are on the wrong side of the thresholds\n");
+    failed = 1;
+  }
+
+  printf("random clock, no monitor:\n");
+  double plain = simulate(0);
+  printf("  %.0f days\n", plain);
+  printf("random clock, with monitor:\n");
+  double monitored = simulate(1);
+  printf("  %.0f days\n", monitored);
+  if (monitored <= plain) {
+    printf("FAIL: the low power modes didn't extend the battery life\n");
+    failed = 1;
+  }
+  return failed;
+}
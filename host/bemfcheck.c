@@ -0,0 +1,183 @@
+/*
+
+ Crazy Clock back-EMF check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and normal.c, built with BEMF_SENSE, in the host
+ * simulator against a model of a Lavet stepping motor, and checks that the
+ * hand never loses a second while the pulses get shorter.
+ *
+ * The model: the rotor sits in one of two detents, one for each coil pin. A
+ * pulse on the other pin steps it if it's at least as long as the movement
+ * needs right now - a few ms, give or take a ms of friction from one step to
+ * the next. A pulse on the pin it's already at does nothing. For a while after
+ * the pulse, the coil's back-EMF says which way the rotor's going: on with the
+ * step, or back where it came from. The rest of the time - or if the coil
+ * isn't left floating - the comparator just sees noise.
+ *
+ * The movement starts out needing NEED_MS, then a cold snap or a tired
+ * battery makes that NEED_MS_LATER. After a battery change, the clock should
+ * pick up where it left off.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <avr/io.h>
+#include "hostsim.h"
+
+#define DAYS (3)
+#define NEED_MS (11)
+#define NEED_MS_LATER (17)
+#define JITTER_MS (1)
+// How long the back-EMF says anything after the pulse ends.
+#define BEMF_WINDOW_MS (10)
+#define MS (32.768)
+#define TICK_LENGTH (30) // as in base.c
+
+static double need_ms = NEED_MS;
+
+static int rotor; // which pin's detent it's in
+static unsigned long steps, pulses, misses;
+static double energy_ms; // of pulse
+static double first_ms;
+
+// The pulse being sent. host_pulse sees it a ms at a time.
+static uint8_t pulse_pins;
+static uint64_t pulse_start, pulse_end;
+// What the last one did.
+static enum { STILL, ON, BACK } motion;
+static int motion_pin;
+static uint64_t motion_end;
+
+static void finishPulse() {
+  if (!pulse_pins) return;
+  int pin = (pulse_pins & _BV(PORTB1)) ? 1 : 0;
+  double ms = (pulse_end - pulse_start) / MS;
+  if (!pulses) first_ms = ms;
+  pulses++;
+  energy_ms += ms;
+  motion_pin = pin;
+  motion_end = pulse_end;
+  if (pin == rotor) {
+    motion = STILL;
+  } else if (ms >= need_ms + JITTER_MS * (2.0 * rand() / RAND_MAX - 1)) {
+    motion = ON;
+    rotor = pin;
+    steps++;
+  } else {
+    motion = BACK;
+    misses++;
+  }
+  pulse_pins = 0;
+}
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  pins &= _BV(PORTB0) | _BV(PORTB1);
+  if (pins == pulse_pins && start == pulse_end) {
+    pulse_end += length;
+    return;
+  }
+  finishPulse();
+  pulse_pins = pins;
+  pulse_start = start;
+  pulse_end = start + length;
+}
+
+static uint8_t comparator(void) {
+  finishPulse();
+  int floating = !(DDRB & (_BV(DDB0) | _BV(DDB1)));
+  if (floating && motion != STILL && host_cycles - motion_end < BEMF_WINDOW_MS * MS) {
+    // AIN0 is PB0. Going on with the step, the driven pin reads higher.
+    int driven_high = motion == ON;
+    return motion_pin == 0 ? driven_high : !driven_high;
+  }
+  return rand() & 1;
+}
+
+static unsigned long expected_steps() {
+  // normal.c ticks at the start of every second.
+  return (unsigned long)(host_cycles / 32768.0) + 1;
+}
+
+static int checkSteps(const char *when) {
+  finishPulse();
+  printf("%s: %lu steps, %lu pulses, %lu missed, %.1f ms a step, learned %d ms\n", when, steps, pulses,
+    misses, energy_ms / steps, host_eeprom[14]);
+  if (steps != expected_steps()) {
+    printf("FAIL: the hand took %lu steps, but should have taken %lu\n", steps, expected_steps());
+    return 1;
+  }
+  return 0;
+}
+
+static int learned;
+
+static int checkFirst(void) {
+  int failed = checkSteps("after a battery change and a day");
+  if (first_ms < learned - 1 || first_ms > learned) {
+    printf("FAIL: the first pulse after a battery change was %.1f ms, not %d\n", first_ms, learned);
+    failed = 1;
+  }
+  return failed;
+}
+
+static uint64_t later;
+
+static void maybeLater(void) {
+  if (host_cycles >= later) need_ms = NEED_MS_LATER;
+}
+
+static int checkLong(void) {
+  int failed = checkSteps("after three days");
+  // A third less energy than fixed pulses, even counting the first day
+  // working its way down, and it found its way back up when it had to.
+  if (energy_ms / steps > TICK_LENGTH * 2 / 3) {
+    printf("FAIL: the pulses should have been shorter\n");
+    failed = 1;
+  }
+  if (host_eeprom[14] < NEED_MS_LATER || host_eeprom[14] > NEED_MS_LATER + JITTER_MS + 3) {
+    printf("FAIL: learned %d ms, for a movement that needs %d\n", host_eeprom[14], NEED_MS_LATER);
+    failed = 1;
+  }
+  return failed;
+}
+
+int main() {
+  int failed = 0;
+  srand(1);
+  host_eeprom[4] = host_eeprom[5] = 0;
+  host_pulse = pulse;
+  host_comparator = comparator;
+  host_isr_hook = maybeLater;
+
+  // It gets harder halfway through, and the third daily save is at the very
+  // end, so the learned length has had a day and a half to settle.
+  later = host_crystal(DAYS * 86400 / 2);
+  host_stop = host_crystal(DAYS * 86400 + 60);
+  if (host_boot(checkLong) != 0) failed = 1;
+
+  // A new battery, but the same movement.
+  need_ms = NEED_MS_LATER;
+  later = 0;
+  learned = host_eeprom[14];
+  host_stop = host_crystal(86400);
+  if (host_boot(checkFirst) != 0) failed = 1;
+  return failed;
+}
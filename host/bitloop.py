@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock telemetry bit loop check
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# base.c's sendByte() is a loop of inline assembly, so that a bit takes the
+# same number of cycles whatever the compiler does. This reads the
+# instructions back out of base.c and adds up their cycles from wcet.py's
+# table, the AVR instruction set manual's: the loop around the wait, less
+# the wait's last branch, has to be TELEMETRY_LOOP_CYCLES, a pass around the
+# wait has to be 3, and the whole bit has to come to F_CPU / TELEMETRY_BAUD.
+#
+# usage: bitloop.py [base.c] [telemetry.h]
+
+import os
+import re
+import sys
+
+from wcet import BRANCHES, CYCLES
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+F_CPU = 32768
+
+
+def cost(op):
+    return 2 if op in BRANCHES else CYCLES.get(op, 1)
+
+
+def main():
+    base = sys.argv[1] if len(sys.argv) > 1 else os.path.join(HERE, '..', 'base.c')
+    telemetry = sys.argv[2] if len(sys.argv) > 2 else os.path.join(HERE, '..', 'telemetry.h')
+    text = open(base).read()
+    m = re.search(r'static void sendByte\(.*?__asm__ __volatile__ \((.*?)\n\s*:', text, re.S)
+    if not m:
+        sys.exit('no bit loop in %s' % base)
+    insns = []
+    for s in re.findall(r'"((?:[^"\\]|\\.)*)"', m.group(1)):
+        for line in s.split('\\n\\t'):
+            line = line.strip()
+            if line:
+                insns.append(line)
+    outer, wait, nops = 0, 0, 0
+    in_wait = False
+    for line in insns:
+        label = re.match(r'(\d+):\s*(.*)', line)
+        if label:
+            in_wait = label.group(1) == '2'
+            line = label.group(2)
+        op = line.split()[0]
+        if op in ('.rept', '.endr'):
+            continue
+        if op == 'nop':
+            nops += 1
+            continue
+        if in_wait:
+            wait += cost(op)
+            if op in BRANCHES:
+                in_wait = False
+        else:
+            outer += cost(op)
+    if nops != 1:
+        sys.exit('the nops should be one nop in a .rept')
+
+    def define(name, where):
+        d = re.search(r'#define %s \((.*)\)' % name, where)
+        if not d:
+            sys.exit('no %s' % name)
+        return int(d.group(1).rstrip('L'))
+    baud = define('TELEMETRY_BAUD', open(telemetry).read())
+    loop = define('TELEMETRY_LOOP_CYCLES', text)
+    bit = F_CPU // baud
+    passes, extra = (bit - loop) // 3, (bit - loop) % 3
+    # The wait's branch isn't taken the last time around.
+    total = outer + wait * passes - 1 + extra
+    print('bit loop: %d cycles around the wait, %d a pass around it, %d passes and %d nops: %d cycles a bit, of %d' % (
+        outer - 1, wait, passes, extra, total, bit))
+    failed = False
+    if outer - 1 != loop:
+        print('FAIL: TELEMETRY_LOOP_CYCLES is %d, but the instructions around the wait take %d' % (loop, outer - 1))
+        failed = True
+    if wait != 3:
+        print('FAIL: a pass around the wait takes %d cycles, not 3' % wait)
+        failed = True
+    if total != bit:
+        print('FAIL: a bit takes %d cycles, not %d' % (total, bit))
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
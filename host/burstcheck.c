@@ -0,0 +1,118 @@
+/*
+
+ Crazy Clock tick burst check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and lazy.c in the host simulator. lazy.c's ticks come in
+ * bursts from doTickBurst(), which compare B starts and ends while the chip
+ * sleeps. Every tick has to be as long as doTick()'s, on the other coil pin
+ * from the last one, and the ones in a burst have to be as far apart as
+ * lazy.c asked. Over the run, there still has to be a tick a second.
+ *
+ * None of that is worth much if the chip doesn't sleep through the ticks,
+ * so it also says how long it was awake, against the busy-wait doTick()
+ * would have spent.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <avr/io.h>
+#include "hostsim.h"
+
+#define DAYS (2)
+#define COUNT_SECONDS (64 / 32768.0)
+// From base.c and lazy.c.
+#define TICK_SECONDS (0.030)
+#define SPACING_SECONDS (0.100)
+// The matches are whole timer counts, and the one after the period's
+// interrupt can be a count late.
+#define LIMIT (2 * COUNT_SECONDS)
+// lazy.c's bursts are up to 30 ticks, and it sleeps off each one after.
+#define AHEAD_LIMIT (30)
+// Wake-ups cost next to nothing in the simulator, so this is generous.
+#define AWAKE_LIMIT (0.1)
+
+static unsigned long ticks, bursts;
+static uint8_t last_pins;
+static uint64_t first, last;
+static double worst_width, worst_spacing, ahead;
+static unsigned long same_pin;
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  if (!(pins & (_BV(PORTB0) | _BV(PORTB1)))) return;
+  double width = host_seconds(length);
+  if (fabs(width - TICK_SECONDS) > worst_width) worst_width = fabs(width - TICK_SECONDS);
+  if (ticks == 0) {
+    first = start;
+    bursts++;
+  } else {
+    if (pins == last_pins) same_pin++;
+    double apart = host_seconds(start - last);
+    // Anything more than a tenth past the spacing is the next burst.
+    if (apart > SPACING_SECONDS + 0.1) {
+      bursts++;
+    } else if (fabs(apart - SPACING_SECONDS) > worst_spacing) {
+      worst_spacing = fabs(apart - SPACING_SECONDS);
+    }
+  }
+  last = start;
+  last_pins = pins;
+  ticks++;
+  double seconds = host_seconds(start - first);
+  if (ticks - 1 - seconds > ahead) ahead = ticks - 1 - seconds;
+}
+
+static int check(void) {
+  int failed = 0;
+  double seconds = host_seconds(host_cycles - first);
+  uint64_t awake = host_cycles - host_sleep_cycles;
+  double busy = ticks * TICK_SECONDS;
+  printf("%lu ticks in %lu bursts over %.0f s: widths within %.1f ms, spacing within %.1f ms, up to %.0f ticks ahead\n",
+    ticks, bursts, seconds, worst_width * 1000, worst_spacing * 1000, ahead);
+  printf("awake %.1f s, against %.1f s of busy-waiting - %.2f%% of the time\n",
+    host_seconds(awake), busy, host_seconds(awake) / host_seconds(host_cycles) * 100);
+  if (worst_width > LIMIT) {
+    printf("FAIL: the ticks should be %.0f ms long, to within %.1f ms\n", TICK_SECONDS * 1000, LIMIT * 1000);
+    failed = 1;
+  }
+  if (worst_spacing > LIMIT) {
+    printf("FAIL: the ticks in a burst should be %.0f ms apart, to within %.1f ms\n", SPACING_SECONDS * 1000, LIMIT * 1000);
+    failed = 1;
+  }
+  if (same_pin != 0) {
+    printf("FAIL: %lu ticks were on the same pin as the one before\n", same_pin);
+    failed = 1;
+  }
+  if (ahead > AHEAD_LIMIT || fabs(ticks - seconds) > AHEAD_LIMIT) {
+    printf("FAIL: it should tick once a second on average\n");
+    failed = 1;
+  }
+  if (host_seconds(awake) > busy * AWAKE_LIMIT) {
+    printf("FAIL: it should sleep through the ticks\n");
+    failed = 1;
+  }
+  return failed;
+}
+
+int main() {
+  host_pulse = pulse;
+  host_stop = host_crystal(DAYS * 86400.0);
+  return host_boot(check) != 0;
+}
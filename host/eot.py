@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock equation of time table generator
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# This writes eot.h for solar.c: how much the equation of time (sundial time
+# minus clock time) changes each day of the year, in units of half a second.
+# The equation of time comes from Smart's formula (Meeus, Astronomical
+# Algorithms, 28.3), which is good to a second or so.
+#
+# The table holds the changes, not the values. They're rounded from the
+# rounded values, so the rounding never adds up. It starts on the February
+# day when the equation of time changes least. That's where solar.c adds its
+# extra day every four years or so to keep up with the seasons, and where the
+# table wraps around, so neither one costs more than a fraction of a second.
+#
+# With --when, it shows the table entry to build the clock with for the given
+# date, and the sundial time to set it to at midnight.
+#
+# usage: eot.py [--year YEAR] > eot.h
+#        eot.py --when YYYY-MM-DD
+
+import argparse
+import datetime
+import math
+import sys
+
+# Half a second, in tenths.
+UNIT = 5
+DAYS = 365
+
+def jd(date):
+  return date.timestamp() / 86400 + 2440587.5
+
+def eot(date):
+  # The equation of time at the given UTC datetime, in seconds. This is
+  # Smart's formula (Meeus 28.3).
+  T = (jd(date) - 2451545.0) / 36525
+  r = math.radians
+  L0 = r(280.46646 + 36000.76983 * T + 0.0003032 * T * T)
+  M = r(357.52911 + 35999.05029 * T - 0.0001537 * T * T)
+  e = 0.016708634 - 0.000042037 * T - 0.0000001267 * T * T
+  y = math.tan(r(23.4392911 - 0.0130042 * T) / 2) ** 2
+  E = (y * math.sin(2 * L0) - 2 * e * math.sin(M) + 4 * e * y * math.sin(M) * math.cos(2 * L0)
+    - y * y * math.sin(4 * L0) / 2 - 5 * e * e * math.sin(2 * M) / 4)
+  return math.degrees(E) * 240 # 4 minutes a degree
+
+def midnight(year, month, day):
+  return datetime.datetime(year, month, day, tzinfo=datetime.timezone.utc)
+
+def first_day(year):
+  # The February day with the smallest change.
+  days = [midnight(year, 2, d) for d in range(1, 28)]
+  return min(days, key=lambda d: abs(eot(d + datetime.timedelta(days=1)) - eot(d)))
+
+def generate(year):
+  start = first_day(year)
+  values = [round(eot(start + datetime.timedelta(days=i)) * 10 / UNIT) for i in range(DAYS)]
+  values.append(values[0]) # wrap around
+  changes = [values[i + 1] - values[i] for i in range(DAYS)]
+  if max(abs(c) for c in changes) > 127:
+    sys.exit("the changes don't fit in a signed char")
+  print("// Generated by host/eot.py - don't edit.")
+  print("//")
+  print("// Entry n is how much the equation of time changes over day n, in units")
+  print("// of EOT_UNIT tenths-of-a-second. Entry 0 is %s, %d, when it's" % (start.strftime("%B %d"), year))
+  print("// %.1f seconds." % eot(start))
+  print()
+  print("#define EOT_DAYS (%d)" % DAYS)
+  print("#define EOT_UNIT (%d) // half a second" % UNIT)
+  print("#define EOT_START_JD (%.1f) // entry 0, for host/eotcheck.c" % jd(start))
+  print()
+  print("static PROGMEM const signed char eot_change[EOT_DAYS] = {")
+  for i in range(0, DAYS, 16):
+    print("  " + " ".join("%d," % c for c in changes[i:i + 16]))
+  print("};")
+
+def when(date):
+  d = datetime.datetime.strptime(date, "%Y-%m-%d").replace(tzinfo=datetime.timezone.utc)
+  start = first_day(d.year)
+  if start > d: start = first_day(d.year - 1)
+  n = (d - start).days % DAYS
+  e = eot(d)
+  print("-DSTART_DAY=%d. At midnight UTC, set the clock %d minutes %.1f seconds %s of mean time." %
+    (n, abs(e) // 60, abs(e) % 60, "ahead" if e >= 0 else "behind"))
+  return 0
+
+def main():
+  parser = argparse.ArgumentParser(description="Generate the equation of time table.")
+  parser.add_argument("--year", type=int, default=2026, help="the year to work it out for")
+  parser.add_argument("--when", metavar="DATE", help="the table entry for the date")
+  args = parser.parse_args()
+  if args.when:
+    sys.exit(when(args.when))
+  generate(args.year)
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,79 @@
+/*
+
+ Crazy Clock equation of time check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and solar.c in the host simulator for a year and a day,
+ * and checks every tick against the equation of time, worked out here from
+ * Smart's formula (Meeus, Astronomical Algorithms, 28.3) - the same one
+ * host/eot.py uses - rather than from the table. So this checks the table's
+ * rounding, its wrap-around and the clock's arithmetic all at once. The hand
+ * should never be more than a second off.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <avr/pgmspace.h>
+#include "hostsim.h"
+#include "../eot.h"
+
+#define DAYS (366)
+#define LIMIT (1.0) // seconds
+
+// The equation of time in seconds, the given number of days after entry 0.
+static double eot(double days) {
+  double T = (EOT_START_JD + days - 2451545.0) / 36525;
+  double L0 = (280.46646 + 36000.76983 * T + 0.0003032 * T * T) * M_PI / 180;
+  double M = (357.52911 + 35999.05029 * T - 0.0001537 * T * T) * M_PI / 180;
+  double e = 0.016708634 - 0.000042037 * T - 0.0000001267 * T * T;
+  double eps = (23.4392911 - 0.0130042 * T) * M_PI / 180;
+  double y = tan(eps / 2) * tan(eps / 2);
+  double E = y * sin(2 * L0) - 2 * e * sin(M) + 4 * e * y * sin(M) * cos(2 * L0)
+    - y * y * sin(4 * L0) / 2 - 5 * e * e * sin(2 * M) / 4;
+  return E * 180 / M_PI * 240; // 4 minutes a degree
+}
+
+static unsigned long ticks;
+static double worst, worst_at;
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  double now = host_seconds(start);
+  // Tick n is n seconds of sundial time after the start.
+  double error = ticks - (now + eot(now / 86400) - eot(0));
+  if (fabs(error) > fabs(worst)) {
+    worst = error;
+    worst_at = now;
+  }
+  ticks++;
+}
+
+int main() {
+  host_eeprom[4] = host_eeprom[5] = 0; // no trim
+  host_pulse = pulse;
+  host_stop = DAYS * 86400ULL * 32768;
+  host_run();
+
+  printf("%lu ticks in %d days, worst %.2f seconds off on day %d\n", ticks, DAYS, worst, (int)(worst_at / 86400));
+  if (fabs(worst) > LIMIT) {
+    printf("FAIL: the hand strayed from sundial time\n");
+    return 1;
+  }
+  return 0;
+}
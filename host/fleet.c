@@ -0,0 +1,177 @@
+/*
+
+ Crazy Clock fleet simulator
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * See fleet.h. ucontext starts each instance on its own stack, once. After
+ * that, switching is gcc's __builtin_setjmp()/__builtin_longjmp(), which
+ * keep just the frame and stack pointers and where to go on - the compiler
+ * saves whatever else is live around the __builtin_setjmp(). So a switch is
+ * a handful of instructions, with no signal mask and no system call. A
+ * function can't __builtin_longjmp() to a buffer it set itself, hence
+ * toHarness() and toClock(). The clock only switches back once a batch,
+ * so between switches, a tenth is just a call to doSleep() or doTick().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "fleet.h"
+#include "hoststubs.h"
+
+// loop() and what it calls need far less than this. Untouched pages of it
+// never get used, so it costs nothing.
+#define STACK_SIZE (64 * 1024)
+#define M (0x7fffffffL)
+
+extern void loop();
+
+// The clock's statics. An empty section isn't there at all, so these are weak.
+extern char __start_clock_data[] __attribute__((weak)), __stop_clock_data[] __attribute__((weak));
+extern char __start_clock_bss[] __attribute__((weak)), __stop_clock_bss[] __attribute__((weak));
+
+struct instance {
+  void *clock[5]; // where its loop() is waiting
+  int32_t seed; // the math relies on 32 bit wraparound, as in base.c
+  uint8_t started;
+  struct host_tasks tasks;
+  char *statics;
+};
+
+static struct instance *instances;
+// Only needed once each, so kept out of the way.
+static ucontext_t *starts;
+static unsigned int instance_count;
+static struct instance *current;
+static void *harness[5];
+static size_t data_size, bss_size;
+// The clock's statics as they are before any instance runs.
+static char *initial_statics;
+// The batch the current instance is running through.
+static uint64_t *batch_ticked;
+static unsigned int batch_tenth, batch_tenths;
+
+// The same generator as base.c, but with the seed per instance.
+unsigned long q_random() {
+  int32_t seed = current->seed;
+  seed = (seed >> 16) + ((seed << 15) & M) - (seed >> 21) - ((seed << 10) & M);
+  if (seed < 0) seed += M;
+  current->seed = seed;
+  return (unsigned long)seed;
+}
+
+static void __attribute__((noinline)) toHarness() {
+  __builtin_longjmp(harness, 1);
+}
+
+static void __attribute__((noinline)) toClock() {
+  __builtin_longjmp(current->clock, 1);
+}
+
+// Kept out of endTenth(), since a function that calls __builtin_setjmp()
+// saves every register, every time.
+static void __attribute__((noinline)) endBatch() {
+  if (!__builtin_setjmp(current->clock)) toHarness();
+}
+
+static void endTenth(uint8_t ticked) {
+  host_run_tasks();
+  if (ticked) batch_ticked[batch_tenth >> 6] |= 1ULL << (batch_tenth & 63);
+  if (++batch_tenth == batch_tenths) endBatch();
+}
+
+void doSleep() {
+  endTenth(0);
+}
+
+void doTick() {
+  endTenth(1);
+}
+
+// A fresh instance starts here, on its own stack.
+static void begin() {
+  while(1) loop();
+}
+
+static void loadStatics(const char *from) {
+  if (data_size) memcpy(__start_clock_data, from, data_size);
+  if (bss_size) memcpy(__start_clock_bss, from + data_size, bss_size);
+}
+
+static void saveStatics(char *to) {
+  if (data_size) memcpy(to, __start_clock_data, data_size);
+  if (bss_size) memcpy(to + data_size, __start_clock_bss, bss_size);
+}
+
+void fleet_start(unsigned int count, uint32_t (*seed)(unsigned int instance)) {
+  data_size = __stop_clock_data - __start_clock_data;
+  bss_size = __stop_clock_bss - __start_clock_bss;
+  size_t statics_size = data_size + bss_size;
+  instances = calloc(count, sizeof(*instances));
+  starts = calloc(count, sizeof(*starts));
+  char *statics = malloc(statics_size * (count + 1));
+  char *stacks = mmap(NULL, (size_t)STACK_SIZE * count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (!instances || !starts || !statics || stacks == MAP_FAILED) {
+    perror("fleet_start");
+    exit(1);
+  }
+  instance_count = count;
+  initial_statics = statics + statics_size * count;
+  saveStatics(initial_statics);
+
+  for(unsigned int i = 0; i < count; i++) {
+    struct instance *in = &instances[i];
+    in->statics = statics + statics_size * i;
+    memcpy(in->statics, initial_statics, statics_size);
+    // base.c never lets the seed be all 0 or all 1, and perturbs it once.
+    in->seed = seed(i);
+    if (in->seed == 0 || (in->seed & M) == M) in->seed = 0x12345678L;
+    current = in;
+    q_random();
+    getcontext(&starts[i]);
+    starts[i].uc_stack.ss_sp = stacks + (size_t)STACK_SIZE * i;
+    // Stagger the tops, or every stack's busy end lands in the same cache sets.
+    starts[i].uc_stack.ss_size = STACK_SIZE - (i % 61) * 64;
+    starts[i].uc_link = NULL;
+    makecontext(&starts[i], begin, 0);
+  }
+}
+
+void fleet_step(unsigned int tenths, uint64_t *ticked) {
+  if (tenths > FLEET_BATCH) tenths = FLEET_BATCH;
+  if (tenths == 0) return;
+  for(unsigned int i = 0; i < instance_count; i++) {
+    current = &instances[i];
+    host_tasks = &current->tasks;
+    batch_ticked = ticked + (size_t)i * FLEET_WORDS;
+    memset(batch_ticked, 0, FLEET_WORDS * sizeof(*batch_ticked));
+    batch_tenth = 0;
+    batch_tenths = tenths;
+    loadStatics(current->statics);
+    if (!__builtin_setjmp(harness)) {
+      if (current->started) toClock();
+      current->started = 1;
+      setcontext(&starts[i]);
+    }
+    saveStatics(current->statics);
+  }
+}
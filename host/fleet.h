@@ -0,0 +1,59 @@
+/*
+
+ Crazy Clock fleet simulator
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs thousands of copies of one clock's unmodified loop() in one
+ * process, each with its own seed. It takes the place of base.c: doTick()
+ * and doSleep() end a tenth-of-a-second, and note in the instance's tick
+ * bitmap whether it ticked. An instance runs through a whole batch of tenths
+ * before it hands control back, and fleet_step() picks the next one up where
+ * it left off.
+ *
+ * Each instance's loop() runs on a small stack of its own, so its local
+ * variables are just where the compiler left them. Its copy of the clock's
+ * static variables is swapped in for the batch. For that, the clock's object
+ * has its .data and .bss renamed to clock_data and clock_bss (see the
+ * Makefile), so that the linker marks where they start and end. A batch is
+ * long enough that the swap and the switch cost next to nothing a tenth.
+ *
+ * There's no timer here. The tasks run every tenth, which is what the host
+ * simulator does too, since code takes no time there.
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdint.h>
+
+// The most tenths fleet_step() runs at a time, and the 64 bit words each
+// instance's ticks take in a batch.
+#define FLEET_BATCH (8192)
+#define FLEET_WORDS (FLEET_BATCH / 64)
+
+// Set up 'count' instances. Each gets the seed seed(i), as if it were in
+// EEPROM - it's perturbed once at the start, just as base.c does.
+void fleet_start(unsigned int count, uint32_t (*seed)(unsigned int instance));
+
+// Run every instance through 'tenths' more tenths, up to FLEET_BATCH. Bit t
+// of instance i's FLEET_WORDS words in ticked (from ticked + i * FLEET_WORDS)
+// says whether it ticked in tenth t of them.
+void fleet_step(unsigned int tenths, uint64_t *ticked);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+
+ Crazy Clock fleet statistics
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs a fleet of one clock type (see fleet.h), each instance with its
+ * own seed, and says how they spread out: ticks per day, how far ahead of
+ * and behind true time they got, and the longest each went without a tick -
+ * the same measures as fuzz.c. Instance 0 gets the seed given with -s, and
+ * the others get seeds scattered from it.
+ *
+ * With -t, it writes instance INDEX's ticks instead, the way hosttrace does,
+ * so that it can be checked against the golden traces.
+ *
+ * usage: fleet-TYPE [-n instances] [-d days] [-s seed] [-t index]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fleet.h"
+
+#define TENTHS_PER_DAY (864000L)
+
+static uint32_t base_seed = 0x12345678;
+
+static uint32_t seedFor(unsigned int instance) {
+  // Neighbouring seeds make neighbouring streams for a while, so spread them.
+  return base_seed ^ (instance * 0x9e3779b9U);
+}
+
+// Kept by field, not by instance, so each pass over the fleet is a straight
+// run through memory.
+static long *ticks, *last_tick, *ahead, *behind, *gap;
+
+static void *allocate(size_t count, size_t size) {
+  void *p = calloc(count, size);
+  if (!p) {
+    perror("fleet");
+    exit(1);
+  }
+  return p;
+}
+
+static void summarize(const char *what, const long *value, unsigned int count, double scale) {
+  long min = value[0], max = value[0];
+  unsigned int min_at = 0, max_at = 0;
+  double sum = 0;
+  for(unsigned int i = 0; i < count; i++) {
+    if (value[i] < min) { min = value[i]; min_at = i; }
+    if (value[i] > max) { max = value[i]; max_at = i; }
+    sum += value[i];
+  }
+  printf("%-14s min %9.1f (0x%08x)  mean %9.1f  max %9.1f (0x%08x)\n", what, min * scale, seedFor(min_at),
+    sum / count * scale, max * scale, seedFor(max_at));
+}
+
+int main(int argc, char **argv) {
+  unsigned int count = 1000;
+  double days = 1;
+  long trace = -1;
+  int c;
+  while((c = getopt(argc, argv, "n:d:s:t:")) != -1) {
+    switch(c) {
+      case 'n': count = strtoul(optarg, NULL, 0); break;
+      case 'd': days = atof(optarg); break;
+      case 's': base_seed = strtoul(optarg, NULL, 0); break;
+      case 't': trace = strtol(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-n instances] [-d days] [-s seed] [-t index]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (count == 0 || trace >= (long)count) {
+    fprintf(stderr, "%s: no instance %ld in a fleet of %u\n", argv[0], trace, count);
+    return 2;
+  }
+  long tenths = (long)(days * TENTHS_PER_DAY);
+
+  uint64_t *ticked = allocate((size_t)count * FLEET_WORDS, sizeof(uint64_t));
+  ticks = allocate(count, sizeof(long));
+  last_tick = allocate(count, sizeof(long));
+  ahead = allocate(count, sizeof(long));
+  behind = allocate(count, sizeof(long));
+  gap = allocate(count, sizeof(long));
+  for(unsigned int i = 0; i < count; i++) {
+    // Right after the first tenth, without a tick, the hand is a tenth behind.
+    ahead[i] = -1;
+    behind[i] = gap[i] = -tenths;
+  }
+
+  clock_t started = clock();
+  fleet_start(count, seedFor);
+  int pin = 0; // base.c's first tick is on the second pin
+  for(long done = 0; done < tenths; done += FLEET_BATCH) {
+    unsigned int batch = tenths - done < FLEET_BATCH ? tenths - done : FLEET_BATCH;
+    fleet_step(batch, ticked);
+    for(unsigned int i = 0; i < count; i++) {
+      if (trace >= 0 && i != trace) continue;
+      const uint64_t *words = ticked + (size_t)i * FLEET_WORDS;
+      for(unsigned int w = 0; w < FLEET_WORDS; w++) {
+        for(uint64_t bits = words[w]; bits; bits &= bits - 1) {
+          long tenth = done + w * 64 + __builtin_ctzll(bits);
+          if (trace >= 0) {
+            printf("%ld %d\n", tenth, pin = !pin);
+            continue;
+          }
+          // The hand is furthest behind just before a tick, and furthest
+          // ahead just after one.
+          if (tenth > 0 && tenth - ticks[i] * 10 > behind[i]) behind[i] = tenth - ticks[i] * 10;
+          ticks[i]++;
+          if (ticks[i] * 10 - (tenth + 1) > ahead[i]) ahead[i] = ticks[i] * 10 - (tenth + 1);
+          if (tenth - last_tick[i] > gap[i]) gap[i] = tenth - last_tick[i];
+          last_tick[i] = tenth;
+        }
+      }
+    }
+  }
+  // Or at the very end.
+  for(unsigned int i = 0; i < count; i++)
+    if (tenths - ticks[i] * 10 > behind[i]) behind[i] = tenths - ticks[i] * 10;
+  if (trace >= 0) return 0;
+  double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+  printf("%u instances, %.1f days each, in %.1f s (%.0f instance-days a second)\n", count, days, seconds,
+    count * days / seconds);
+  summarize("ticks a day", ticks, count, 1 / days);
+  summarize("ahead, s", ahead, count, 0.1);
+  summarize("behind, s", behind, count, 0.1);
+  summarize("longest gap, s", gap, count, 0.1);
+  return 0;
+}
@@ -0,0 +1,402 @@
+/*
+
+ Crazy Clock worst case search
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This searches for the q_random() streams that make a clock stray furthest
+ * from true time, ahead and behind, and go longest without a tick. Picking
+ * the numbers at random, like test.c does, almost never gets there.
+ *
+ * It's linked with the clock code, which is built with gcc's
+ * -fsanitize-coverage=trace-pc so that every branch the clock takes is seen
+ * here. Like test.c, doTick() and doSleep() just count, and the tasks run
+ * every tenth. An input is a short list of numbers for q_random() to return,
+ * over and over. Each run is RUN_TENTHS long, in a child process so that the
+ * clock's variables start fresh.
+ *
+ * Inputs are mutated - numbers changed, swapped, copied, cut out - and kept
+ * if they take the clock somewhere new, or further than before: a new
+ * branch, a branch taken a new number of times (in powers of 2, the way AFL
+ * does it), or a new worst case. At the end, each worst case is shrunk to the
+ * simplest input that still gets there, and with -o, written out. -r replays
+ * one of those.
+ *
+ * usage: fuzz-TYPE [-n runs] [-t seconds] [-s seed] [-o prefix]
+ *        fuzz-TYPE -r file
+ */
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hoststubs.h"
+
+#ifndef RUN_TENTHS
+#define RUN_TENTHS (36000L) // an hour
+#endif
+#define MAX_INPUT (256)
+#define MAX_CORPUS (4096)
+#define MAP_SIZE (1 << 16)
+#define M (0x7fffffffL)
+
+enum { AHEAD, BEHIND, GAP, GOALS };
+static const char *goal_names[GOALS] = { "ahead", "behind", "gap" };
+
+struct input {
+  int length;
+  uint32_t value[MAX_INPUT];
+};
+
+// What one run found. This is shared with the child that does the run.
+struct result {
+  long worst[GOALS]; // in tenths
+  long when[GOALS]; // the tenth each was reached
+  uint8_t map[MAP_SIZE];
+};
+static struct result *result;
+
+extern void loop();
+
+// The clock's side of things, in the child.
+
+static const struct input *feed;
+static int feed_pos;
+static long tenth, ticks, last_tick;
+static jmp_buf done;
+static uintptr_t prev_pc;
+
+unsigned long q_random() {
+  uint32_t value = feed->value[feed_pos];
+  if (++feed_pos >= feed->length) feed_pos = 0;
+  return value & M; // it's 31 bits
+}
+
+static void note(long goal, long value) {
+  if (value > result->worst[goal]) {
+    result->worst[goal] = value;
+    result->when[goal] = tenth;
+  }
+}
+
+// Every call is the end of one tenth.
+static void endTenth(int tick) {
+  host_run_tasks();
+  if (tick) {
+    note(GAP, tenth - last_tick);
+    last_tick = tenth;
+    ticks++;
+  }
+  // How far the hand is from true time, right after this tenth.
+  long offset = ticks * 10 - (tenth + 1);
+  note(AHEAD, offset);
+  note(BEHIND, -offset);
+  if (++tenth >= RUN_TENTHS) longjmp(done, 1);
+}
+
+void doSleep() {
+  endTenth(0);
+}
+
+void doTick() {
+  endTenth(1);
+}
+
+void __sanitizer_cov_trace_pc(void) {
+  uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+  pc = (pc ^ (pc >> 7)) * 0x9e3779b1u;
+  uint8_t *hits = result->map + ((pc ^ prev_pc) % MAP_SIZE);
+  if (*hits < 255) (*hits)++;
+  prev_pc = pc >> 1;
+}
+
+// The harness's side.
+
+static int run(const struct input *in) {
+  memset(result, 0, sizeof(*result));
+  for(int i = 0; i < GOALS; i++) result->worst[i] = -RUN_TENTHS;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(2);
+  }
+  if (pid == 0) {
+    feed = in;
+    alarm(10); // a clock that never sleeps would hang the search
+    if (!setjmp(done)) while(1) loop();
+    _exit(0);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "the clock crashed or hung\n");
+    return -1;
+  }
+  return 0;
+}
+
+// The harness's own generator. It has nothing to do with q_random().
+static uint64_t rng_state;
+
+static uint32_t rng() {
+  rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return rng_state >> 33;
+}
+
+// Hit counts are bucketed in powers of 2, so that a loop going around 5
+// times instead of 4 isn't news, but 8 instead of 4 is.
+static uint8_t bucket(uint8_t hits) {
+  uint8_t b = 0;
+  while(hits) {
+    b++;
+    hits >>= 1;
+  }
+  return b ? 1 << (b - 1) : 0;
+}
+
+static uint8_t seen[MAP_SIZE];
+
+static int newCoverage() {
+  int found = 0;
+  for(int i = 0; i < MAP_SIZE; i++) {
+    if (!result->map[i]) continue;
+    uint8_t b = bucket(result->map[i]);
+    if (!(seen[i] & b)) {
+      seen[i] |= b;
+      found = 1;
+    }
+  }
+  return found;
+}
+
+// Values that tend to be at the edges of 'q_random() % n'.
+static uint32_t interesting() {
+  static const uint32_t values[] = { 0, 1, 2, 3, 4, 5, 29, 30, 59, 60, 0xff, 0x100, 0xffff, M - 1, M };
+  uint32_t v = values[rng() % (sizeof(values) / sizeof(values[0]))];
+  // Or a small number times something, which covers most moduli.
+  if (rng() % 2) v = (rng() % 64) * (rng() % 2 ? 1 : 360360); // 360360 divides by 1 to 15
+  return v;
+}
+
+static void mutate(struct input *in, const struct input *other) {
+  int changes = 1 + rng() % 4;
+  while(changes--) {
+    int pos = rng() % in->length;
+    switch(rng() % 8) {
+      case 0:
+        in->value[pos] = rng() ^ (rng() << 16);
+        break;
+      case 1:
+        in->value[pos] = interesting();
+        break;
+      case 2:
+        in->value[pos] ^= 0xffu << (8 * (rng() % 4));
+        break;
+      case 3:
+        in->value[pos] += (int)(rng() % 33) - 16;
+        break;
+      case 4: { // copy a stretch over another
+        int from = rng() % in->length, len = 1 + rng() % 8;
+        for(int i = 0; i < len && from + i < in->length && pos + i < in->length; i++)
+          in->value[pos + i] = in->value[from + i];
+        break;
+      }
+      case 5: // cut one out
+        if (in->length > 1) {
+          memmove(in->value + pos, in->value + pos + 1, (in->length - pos - 1) * sizeof(uint32_t));
+          in->length--;
+        }
+        break;
+      case 6: // put one in
+        if (in->length < MAX_INPUT) {
+          memmove(in->value + pos + 1, in->value + pos, (in->length - pos) * sizeof(uint32_t));
+          in->value[pos] = rng();
+          in->length++;
+        }
+        break;
+      case 7: { // take the tail from another input
+        int len = other->length - pos;
+        if (len > 0) {
+          memcpy(in->value + pos, other->value + pos, len * sizeof(uint32_t));
+          in->length = other->length;
+        }
+        break;
+      }
+    }
+  }
+}
+
+static struct input corpus[MAX_CORPUS];
+static int corpus_count;
+static struct input best[GOALS];
+static long best_worst[GOALS], best_when[GOALS];
+static unsigned long runs;
+
+static int improves(int goal) {
+  return result->worst[goal] > best_worst[goal];
+}
+
+static void keep(const struct input *in) {
+  if (corpus_count < MAX_CORPUS)
+    corpus[corpus_count++] = *in;
+  else
+    corpus[rng() % MAX_CORPUS] = *in;
+}
+
+static void consider(const struct input *in) {
+  if (run(in)) return;
+  runs++;
+  int interesting = newCoverage();
+  for(int g = 0; g < GOALS; g++) {
+    if (!improves(g)) continue;
+    best[g] = *in;
+    best_worst[g] = result->worst[g];
+    best_when[g] = result->when[g];
+    printf("run %lu: %s %.1f s, at tenth %ld\n", runs, goal_names[g], best_worst[g] / 10.0, best_when[g]);
+    interesting = 1;
+  }
+  if (interesting) keep(in);
+}
+
+// Does this input still get at least as far for this goal?
+static int holds(const struct input *in, int goal) {
+  return run(in) == 0 && result->worst[goal] >= best_worst[goal];
+}
+
+// Cut out as much as possible, then make the numbers as small as possible.
+static void shrink(int goal) {
+  struct input *in = &best[goal], trial;
+  for(int chunk = in->length / 2; chunk >= 1; chunk /= 2) {
+    for(int pos = 0; pos + chunk <= in->length && in->length > chunk; ) {
+      trial = *in;
+      memmove(trial.value + pos, trial.value + pos + chunk, (trial.length - pos - chunk) * sizeof(uint32_t));
+      trial.length -= chunk;
+      if (holds(&trial, goal))
+        *in = trial;
+      else
+        pos += chunk;
+    }
+  }
+  for(int pos = 0; pos < in->length; pos++) {
+    // The smallest number that leaves the low bits alone often does it.
+    static const uint32_t masks[] = { 0, 0xff, 0xffff };
+    for(unsigned int m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+      trial = *in;
+      trial.value[pos] &= masks[m];
+      if (trial.value[pos] == in->value[pos]) break;
+      if (holds(&trial, goal)) {
+        *in = trial;
+        break;
+      }
+    }
+  }
+  run(in);
+  best_when[goal] = result->when[goal];
+}
+
+static int save(const char *file, int goal) {
+  FILE *f = fopen(file, "w");
+  if (!f) return -1;
+  fprintf(f, "# %s %.1f s, at tenth %ld of %ld\n", goal_names[goal], best_worst[goal] / 10.0, best_when[goal], RUN_TENTHS);
+  for(int i = 0; i < best[goal].length; i++) fprintf(f, "%08lx\n", (unsigned long)best[goal].value[i]);
+  return fclose(f);
+}
+
+static int replay(const char *file) {
+  FILE *f = fopen(file, "r");
+  if (!f) {
+    perror(file);
+    return 2;
+  }
+  struct input in = { 0 };
+  char line[64];
+  while(fgets(line, sizeof(line), f) && in.length < MAX_INPUT)
+    if (line[0] != '#') in.value[in.length++] = strtoul(line, NULL, 16);
+  fclose(f);
+  if (!in.length || run(&in)) return 2;
+  for(int g = 0; g < GOALS; g++)
+    printf("%s %.1f s, at tenth %ld\n", goal_names[g], result->worst[g] / 10.0, result->when[g]);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long max_runs = 0;
+  double seconds = 60;
+  unsigned long seed = 1;
+  const char *prefix = NULL, *replay_file = NULL;
+  int opt;
+  while((opt = getopt(argc, argv, "n:t:s:o:r:")) != -1) {
+    switch(opt) {
+      case 'n': max_runs = strtoul(optarg, NULL, 0); break;
+      case 't': seconds = atof(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      case 'o': prefix = optarg; break;
+      case 'r': replay_file = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-n runs] [-t seconds] [-s seed] [-o prefix]\n       %s -r file\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+  result = mmap(NULL, sizeof(*result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (result == MAP_FAILED) {
+    perror("mmap");
+    return 2;
+  }
+  if (replay_file) return replay(replay_file);
+
+  rng_state = seed;
+  for(int g = 0; g < GOALS; g++) best_worst[g] = -RUN_TENTHS - 1;
+  // Start with a few plain random streams.
+  for(int i = 0; i < 16; i++) {
+    struct input in;
+    in.length = 1 + rng() % 64;
+    for(int j = 0; j < in.length; j++) in.value[j] = rng() ^ (rng() << 16);
+    consider(&in);
+  }
+  time_t start = time(NULL);
+  while(max_runs ? runs < max_runs : difftime(time(NULL), start) < seconds) {
+    // Half the time, work on one of the best so far.
+    const struct input *parent = (rng() % 2) ? &best[rng() % GOALS] : &corpus[rng() % corpus_count];
+    struct input in = *parent;
+    mutate(&in, &corpus[rng() % corpus_count]);
+    consider(&in);
+  }
+
+  printf("%lu runs of %.1f hours, %d kept\n", runs, RUN_TENTHS / 36000.0, corpus_count);
+  int failed = 0;
+  for(int g = 0; g < GOALS; g++) {
+    shrink(g);
+    printf("worst %s: %.1f s, at tenth %ld, from %d numbers\n", goal_names[g], best_worst[g] / 10.0,
+      best_when[g], best[g].length);
+    if (prefix) {
+      char file[256];
+      snprintf(file, sizeof(file), "%s.%s", prefix, goal_names[g]);
+      if (save(file, g)) {
+        perror(file);
+        failed = 1;
+      }
+    }
+  }
+  return failed;
+}
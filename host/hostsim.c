@@ -0,0 +1,479 @@
+/*
+
+ Crazy Clock host simulator
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "hostsim.h"
+
+volatile uint8_t PORTA, DDRA, PORTB, DDRB;
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK, TIMSK0;
+volatile uint8_t ADMUX, DIDR0;
+volatile uint8_t MCUCR, GIMSK;
+volatile uint16_t SP;
+unsigned char __heap_start;
+volatile uint16_t ADC;
+#ifdef HOST_RTC
+VPORT_t VPORTA, VPORTB;
+CLKCTRL_t CLKCTRL;
+#endif
+uint8_t host_sleep_mode;
+
+uint64_t host_cycles;
+double host_ppm;
+uint64_t host_stop;
+uint8_t *host_eeprom;
+unsigned long host_isr_count;
+unsigned long host_isr_awake;
+uint64_t host_sleep_cycles;
+uint64_t (*host_work)(void);
+void (*host_pulse)(uint8_t pins, uint64_t start, uint64_t length);
+void (*host_delay_hook)(uint64_t start, uint64_t length);
+unsigned int (*host_adc)(uint8_t admux);
+uint8_t (*host_comparator)(void);
+uint64_t (*host_int0)(uint64_t after);
+void (*host_isr_hook)(void);
+
+#ifdef HOST_RTC
+extern void RTC_CNT_vect(void);
+#define TIMER_VECT RTC_CNT_vect
+#else
+extern void TIM0_COMPA_vect(void);
+#define TIMER_VECT TIM0_COMPA_vect
+#endif
+// Only the sweep drive and the tick bursts have a compare B ISR.
+extern void TIM0_COMPB_vect(void) __attribute__((weak));
+// Only PPS_DISCIPLINE has an INT0 ISR, and the tiny44 calls it something else.
+extern void INT0_vect(void) __attribute__((weak));
+extern void EXT_INT0_vect(void) __attribute__((weak));
+extern void base_main(void);
+
+static jmp_buf done;
+static uint8_t interrupts; // the I bit in SREG
+static uint8_t saved_interrupts; // a stack of them, for ATOMIC_BLOCK
+static uint8_t sleeping;
+static uint8_t pending; // the compare flag
+static uint8_t pending_b; // and the one for compare B
+static uint64_t matched_b = UINT64_MAX; // the cycle compare B last matched at
+static uint8_t pending_int0;
+static uint64_t next_edge; // on INT0
+static uint64_t period_start; // when TCNT0 was last reset to 0
+static volatile uint8_t adcsra;
+static volatile uint8_t acsr;
+static volatile uint8_t tcnt0;
+#ifdef HOST_RTC
+static RTC_t rtc;
+static uint16_t rtc_cnt_seen;
+static uint8_t rtc_flags_seen;
+static uint8_t rtc_cleared; // the code wrote the overflow flag
+#else
+static uint8_t last_top; // OCR0A at the last match
+static uint8_t tcnt0_seen;
+#endif
+
+static unsigned int prescale() {
+#ifdef HOST_RTC
+  return (rtc.CTRLA & RTC_RTCEN_bm) ? 1 : 0;
+#else
+  switch(TCCR0B & (_BV(CS02) | _BV(CS01) | _BV(CS00))) {
+    case 1: return 1;
+    case 2: return 8;
+    case 3: return 64;
+    case 4: return 256;
+    case 5: return 1024;
+    default: return 0; // stopped
+  }
+#endif
+}
+
+static uint8_t timerEnabled() {
+#ifdef HOST_RTC
+  return rtc.INTCTRL & RTC_OVF_bm;
+#else
+  return (TIMSK & _BV(OCIE0A)) || (TIMSK0 & _BV(OCIE0A));
+#endif
+}
+
+static uint8_t int0Enabled() {
+  return (INT0_vect || EXT_INT0_vect) && (GIMSK & _BV(INT0)) &&
+    (MCUCR & (_BV(ISC01) | _BV(ISC00))) == (_BV(ISC01) | _BV(ISC00));
+}
+
+static uint8_t compareBEnabled() {
+  return TIM0_COMPB_vect && ((TIMSK & _BV(OCIE0B)) || (TIMSK0 & _BV(OCIE0B)));
+}
+
+// If the code wrote TCNT0 since we last looked, restart the period from
+// here. Either way, bring it up to date.
+static void syncTimer() {
+  unsigned int ps = prescale();
+#ifdef HOST_RTC
+  // The RTC counts from 0 to PER and sets its flag as it goes back to 0.
+  if (rtc.CNT != rtc_cnt_seen)
+    period_start = host_cycles - rtc.CNT;
+  if (ps)
+    rtc.CNT = (uint16_t)(host_cycles - period_start);
+  rtc_cnt_seen = rtc.CNT;
+  if (rtc.INTFLAGS != rtc_flags_seen && (rtc.INTFLAGS & RTC_OVF_bm))
+    rtc_cleared = 1;
+  rtc_flags_seen = rtc.INTFLAGS = pending ? RTC_OVF_bm : 0;
+#else
+  if (tcnt0 != tcnt0_seen)
+    period_start = host_cycles - (uint64_t)tcnt0 * ps;
+  if (host_cycles < period_start)
+    tcnt0 = last_top; // it's matched, but hasn't reset yet
+  else if (ps)
+    tcnt0 = (uint8_t)((host_cycles - period_start) / ps);
+  tcnt0_seen = tcnt0;
+#endif
+}
+
+volatile uint8_t *host_tcnt0(void) {
+  syncTimer();
+  return &tcnt0;
+}
+
+#ifdef HOST_RTC
+RTC_t *host_rtc(void) {
+  syncTimer();
+  return &rtc;
+}
+#endif
+
+volatile uint8_t *host_tifr(void) {
+  static volatile uint8_t tifr;
+  tifr = pending ? _BV(OCF0A) : 0;
+  return &tifr;
+}
+
+// The EEPROM is shared with any children, so it survives a host_boot().
+__attribute__((constructor)) static void eraseEEPROM() {
+  host_eeprom = mmap(NULL, HOST_EEPROM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (host_eeprom == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  memset(host_eeprom, 0xff, HOST_EEPROM_SIZE);
+}
+
+double host_seconds(uint64_t cycles) {
+  return cycles / (32768.0 * (1 + host_ppm / 1e6));
+}
+
+uint64_t host_crystal(double seconds) {
+  return (uint64_t)(seconds * 32768.0 * (1 + host_ppm / 1e6));
+}
+
+static unsigned int defaultADC(uint8_t admux) {
+  if ((admux & 0x0f) == 0x0f || (admux & 0x3f) == 0x22) return 300; // temperature
+  return 1100L * 1024 / 3000; // bandgap, with VCC as the reference
+}
+
+// The pins a pulse could be on.
+static uint8_t coilPins() {
+#ifdef HOST_RTC
+  return VPORTA.OUT | VPORTB.OUT;
+#else
+  return PORTA | PORTB;
+#endif
+}
+
+// Pulses the ISRs end, rather than a _delay_ms(). They start when an ISR
+// sets the pin, or by the time the clock code sleeps with it set.
+static uint8_t isr_pins;
+static uint64_t isr_rise;
+
+static void watchPins(uint8_t before) {
+  uint8_t after = coilPins();
+  uint8_t fell = before & ~after & isr_pins;
+  if (fell) {
+    isr_pins &= ~fell;
+    if (host_pulse) host_pulse(fell, isr_rise, host_cycles - isr_rise);
+  }
+  if (after & ~before) {
+    isr_pins |= after & ~before;
+    isr_rise = host_cycles;
+  }
+}
+
+static void callISR(void (*isr)(void)) {
+  uint8_t pins = coilPins();
+  sleeping = 0;
+  uint8_t save = interrupts;
+  interrupts = 0;
+  isr();
+  interrupts = save;
+  watchPins(pins);
+  if (host_isr_hook) host_isr_hook();
+}
+
+// INT0 comes first, then compare A, then compare B, just like the vector
+// table.
+static void runPending() {
+  if (pending_int0) {
+    pending_int0 = 0;
+    callISR(INT0_vect ? INT0_vect : EXT_INT0_vect);
+  }
+  if (pending) {
+    pending = 0;
+    host_isr_count++;
+    if (!sleeping) host_isr_awake++;
+#ifdef HOST_RTC
+    rtc_cleared = 0;
+#endif
+    callISR(TIMER_VECT);
+    syncTimer(); // the ISR may have changed OCR0A
+#ifdef HOST_RTC
+    if (!rtc_cleared) {
+      fprintf(stderr, "the RTC ISR left its flag set at cycle %llu\n", (unsigned long long)host_cycles);
+      exit(1);
+    }
+#endif
+  }
+  if (pending_b) {
+    pending_b = 0;
+    callISR(TIM0_COMPB_vect);
+  }
+}
+
+// Run the timer up to the given cycle. If we're asleep, stop at the
+// first interrupt instead.
+static void advance(uint64_t until) {
+  syncTimer();
+  unsigned int ps = prescale();
+  // Edges while the timer was stopped went by unseen.
+  if (next_edge < host_cycles) next_edge = host_int0(host_cycles);
+  while(ps) {
+    // Compare B only matters if it's enabled in time to see TCNT0 reach it.
+    uint64_t match_b = period_start + (uint64_t)OCR0B * ps;
+    uint8_t b_due = match_b != matched_b && OCR0B < OCR0A && match_b >= host_cycles && match_b <= until && compareBEnabled();
+#ifdef HOST_RTC
+    uint64_t match = period_start + rtc.PER + 1;
+#else
+    uint64_t match = period_start + (uint64_t)OCR0A * ps;
+#endif
+    if (next_edge <= until && next_edge <= match && !(b_due && match_b < next_edge)) {
+      host_cycles = next_edge;
+      next_edge = host_int0(next_edge + 1);
+      if (int0Enabled()) pending_int0 = 1;
+      if (pending_int0 && interrupts) {
+        uint8_t woke = sleeping;
+        runPending();
+        if (woke) return;
+      }
+      continue;
+    }
+    if (b_due) {
+      host_cycles = match_b;
+      matched_b = match_b;
+      pending_b = 1;
+      if (interrupts) {
+        uint8_t woke = sleeping;
+        runPending();
+        if (woke) return;
+      }
+      continue;
+    }
+    // TCNT0 matches OCR0A here, and resets to 0 one count later.
+    if (match > until) break;
+    host_cycles = match;
+#ifdef HOST_RTC
+    period_start = match;
+#else
+    period_start = match + ps;
+    tcnt0_seen = tcnt0 = last_top = OCR0A;
+#endif
+    if (timerEnabled()) pending = 1;
+    if (pending && interrupts) {
+      uint8_t woke = sleeping;
+      runPending();
+      if (woke) return;
+    }
+  }
+  if (sleeping) {
+    fprintf(stderr, "sleeping forever at cycle %llu\n", (unsigned long long)host_cycles);
+    exit(1);
+  }
+  host_cycles = until;
+  syncTimer();
+}
+
+void host_advance(uint64_t until) {
+  advance(until);
+}
+
+void host_sleep(void) {
+  if (host_cycles >= host_stop) longjmp(done, 1);
+  if (!interrupts) {
+    fprintf(stderr, "sleep with interrupts off at cycle %llu\n", (unsigned long long)host_cycles);
+    exit(1);
+  }
+#ifdef HOST_RTC
+  if (host_sleep_mode != SLEEP_MODE_STANDBY || !(rtc.CTRLA & RTC_RUNSTDBY_bm) || rtc.CLKSEL != RTC_CLKSEL_TOSC32K_gc) {
+    fprintf(stderr, "the RTC wouldn't count the crystal in this sleep\n");
+    exit(1);
+  }
+  if (!(CLKCTRL.XOSC32KCTRLA & CLKCTRL_ENABLE_bm) || CLKCTRL.MCLKCTRLA != CLKCTRL_CLKSEL_XOSC32K_gc ||
+      (CLKCTRL.MCLKCTRLB & CLKCTRL_PEN_bm)) {
+    fprintf(stderr, "the main clock isn't the crystal, undivided\n");
+    exit(1);
+  }
+#else
+  if (host_sleep_mode != SLEEP_MODE_IDLE) {
+    fprintf(stderr, "Timer0 stops in this sleep\n");
+    exit(1);
+  }
+#endif
+  if (pending || pending_b || pending_int0) { // wakes right back up
+    runPending();
+    return;
+  }
+  if (coilPins() & ~isr_pins) {
+    isr_pins |= coilPins();
+    isr_rise = host_cycles;
+  }
+  sleeping = 1;
+  uint64_t start = host_cycles;
+  advance(UINT64_MAX);
+  host_sleep_cycles += host_cycles - start;
+}
+
+volatile uint8_t *host_adcsra(void) {
+  if ((adcsra & _BV(ADEN)) && (adcsra & _BV(ADSC))) {
+    // A conversion is 13 ADC clocks, and the ADC clock is at least 2 cycles.
+    advance(host_cycles + 26);
+    ADC = (host_adc ? host_adc : defaultADC)(ADMUX);
+    adcsra &= ~_BV(ADSC);
+  }
+  return &adcsra;
+}
+
+volatile uint8_t *host_acsr(void) {
+  if (!(acsr & _BV(ACD))) {
+    if (host_comparator && host_comparator())
+      acsr |= _BV(ACO);
+    else
+      acsr &= ~_BV(ACO);
+  }
+  return &acsr;
+}
+
+void host_delay(uint64_t cycles) {
+  uint8_t pins = coilPins();
+  uint64_t start = host_cycles;
+  advance(host_cycles + cycles);
+  if (host_delay_hook) host_delay_hook(start, cycles);
+  if (pins && host_pulse) host_pulse(pins, start, cycles);
+}
+
+void host_sei(void) {
+  interrupts = 1;
+  runPending();
+}
+
+void host_cli(void) {
+  interrupts = 0;
+}
+
+void host_atomic_enter(void) {
+  if (host_work && interrupts) {
+    uint64_t cycles = host_work();
+    if (cycles) advance(host_cycles + cycles);
+  }
+  saved_interrupts = (saved_interrupts << 1) | interrupts;
+  interrupts = 0;
+}
+
+uint8_t host_atomic_exit(void) {
+  interrupts = saved_interrupts & 1;
+  saved_interrupts >>= 1;
+  if (interrupts) runPending();
+  return 0;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+  return host_eeprom[(uintptr_t)addr];
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr) {
+  uint16_t v;
+  memcpy(&v, host_eeprom + (uintptr_t)addr, sizeof(v));
+  return v;
+}
+
+uint32_t eeprom_read_dword(const uint32_t *addr) {
+  uint32_t v;
+  memcpy(&v, host_eeprom + (uintptr_t)addr, sizeof(v));
+  return v;
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+  host_eeprom[(uintptr_t)addr] = value;
+}
+
+void eeprom_update_word(uint16_t *addr, uint16_t value) {
+  memcpy(host_eeprom + (uintptr_t)addr, &value, sizeof(value));
+}
+
+void eeprom_update_dword(uint32_t *addr, uint32_t value) {
+  memcpy(host_eeprom + (uintptr_t)addr, &value, sizeof(value));
+}
+
+void host_run(void) {
+  host_cycles = 0;
+  period_start = 0;
+  host_sleep_mode = SLEEP_MODE_IDLE;
+#ifdef HOST_RTC
+  memset(&rtc, 0, sizeof(rtc));
+  rtc_cnt_seen = rtc_flags_seen = 0;
+  CLKCTRL.MCLKCTRLA = 0; // the 20 MHz oscillator
+  CLKCTRL.MCLKCTRLB = CLKCTRL_PDIV_6X_gc | CLKCTRL_PEN_bm;
+#endif
+  interrupts = sleeping = pending = pending_b = pending_int0 = 0;
+  matched_b = UINT64_MAX;
+  isr_pins = 0;
+  next_edge = host_int0 ? host_int0(0) : UINT64_MAX;
+  if (!setjmp(done)) base_main();
+}
+
+int host_boot(int (*check)(void)) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if (pid == 0) {
+    host_run();
+    int result = check();
+    fflush(stdout);
+    _exit(result);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) return -1;
+  return WEXITSTATUS(status);
+}
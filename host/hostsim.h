@@ -0,0 +1,111 @@
+/*
+
+ Crazy Clock host simulator
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This is the host side of the avr/ and util/ shim headers in this directory.
+ * With them, the real base.c and clock code compile natively. Time only
+ * passes inside the shim - sleep_mode(), _delay_ms() and so on - and it's
+ * counted in crystal cycles. Timer0 is emulated well enough to fire the
+ * compare ISRs at the right cycle. Built for an ATtiny1614 (see hal_rtc.h),
+ * it's the RTC's overflow instead, and the simulator stops if the clocks and
+ * sleep mode aren't set up for the RTC to keep counting the crystal.
+ *
+ * The crystal can be given a frequency error, so that trim correction can be
+ * checked against real time.
+ *
+ * The harness sets up the hooks, then calls host_run(), which returns once
+ * the clock goes to sleep at or after host_stop. host_boot() does the same
+ * in a child process, which is a power-on reset: all of the firmware's
+ * variables start fresh, but the EEPROM is shared and persists.
+ */
+
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+#include <stdint.h>
+
+// Crystal cycles since reset.
+extern uint64_t host_cycles;
+// The crystal's frequency error, in ppm. Positive is fast.
+extern double host_ppm;
+// host_run() returns when the clock sleeps at or after this cycle.
+extern uint64_t host_stop;
+
+// This starts out erased - all ones.
+extern uint8_t *host_eeprom;
+#define HOST_EEPROM_SIZE (512)
+
+// How many times the timer ISR has run, and how many of those happened
+// while the CPU was awake (that is, the clock code overran).
+extern unsigned long host_isr_count;
+extern unsigned long host_isr_awake;
+
+// Crystal cycles spent in sleep_mode().
+extern uint64_t host_sleep_cycles;
+
+// If set, this is called at the top of every ATOMIC_BLOCK with interrupts
+// still enabled, and returns the number of cycles of "work" to pretend the
+// clock code did just before it.
+extern uint64_t (*host_work)(void);
+
+// If set, this is called for every _delay_ms() that happens while one of
+// the given port bits is high - that is, every tick pulse. A pulse that an
+// ISR ends, like a doTickBurst() tick, is reported when it ends.
+extern void (*host_pulse)(uint8_t pins, uint64_t start, uint64_t length);
+
+// If set, this is called for every delay, whatever the pins are doing, so
+// that a harness can follow a line the firmware bit-bangs.
+extern void (*host_delay_hook)(uint64_t start, uint64_t length);
+
+// If set, this supplies ADC conversion results for the given ADMUX. By
+// default, the temperature sensor reads 300 (25 C) and the bandgap reads
+// as if VCC were 3 volts.
+extern unsigned int (*host_adc)(uint8_t admux);
+
+// If set, this is the analog comparator's output - whether AIN0 (PB0) is
+// above AIN1 (PB1) - each time ACSR is read with the comparator on.
+// Otherwise it reads low.
+extern uint8_t (*host_comparator)(void);
+
+// If set, this gives the crystal cycle of the first rising edge on INT0
+// (PB2) at or after the given one, so that a harness can feed in a
+// reference signal. It's asked for each edge in turn.
+extern uint64_t (*host_int0)(uint64_t after);
+
+// If set, this is called after every ISR, so that a harness can watch pins
+// that the ISRs drive themselves.
+extern void (*host_isr_hook)(void);
+
+// Pass the time until the given cycle, running the ISR as required.
+void host_advance(uint64_t until);
+
+// Real time, in seconds, at the given crystal cycle.
+double host_seconds(uint64_t cycles);
+
+// The number of crystal cycles in the given number of real seconds.
+uint64_t host_crystal(double seconds);
+
+void host_run(void);
+
+// Run the firmware in a fresh child process, then call check() there. Returns
+// check()'s return value, or -1 if the child died.
+int host_boot(int (*check)(void));
+
+#endif
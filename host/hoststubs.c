@@ -0,0 +1,67 @@
+/*
+
+ Crazy Clock host stubs
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// See hoststubs.h.
+
+#include "../base.h"
+#include "hoststubs.h"
+
+static struct host_tasks tasks;
+struct host_tasks *host_tasks = &tasks;
+
+void addTask(void (*run)(), unsigned long period, unsigned char cost) {
+  if (host_tasks->count >= HOST_MAX_TASKS) return;
+  struct host_task *t = &host_tasks->task[host_tasks->count++];
+  t->run = run;
+  t->period = t->countdown = period;
+}
+
+void host_run_tasks(void) {
+  for(unsigned char i = 0; i < host_tasks->count; i++) {
+    struct host_task *t = &host_tasks->task[i];
+    if (t->countdown != 0 && --t->countdown != 0) continue;
+    t->run();
+    t->countdown = t->period;
+  }
+}
+
+// The spacing, held to what base.c allows.
+static unsigned int clampSpacing(unsigned int spacing) {
+  if (spacing < BURST_MIN_SPACING) return BURST_MIN_SPACING;
+  if (spacing > BURST_MAX_SPACING) return BURST_MAX_SPACING;
+  return spacing;
+}
+
+unsigned int doTickBurst(unsigned char count, unsigned int spacing) {
+  // The nearest whole number of tenths, but never less than one.
+  unsigned int gap = (clampSpacing(spacing) + 50) / 100;
+  if (gap == 0) gap = 1;
+  unsigned int tenths = 0;
+  while(count != 0) {
+    doTick();
+    tenths++;
+    if (--count == 0) break;
+    for(unsigned int i = 1; i < gap; i++) {
+      doSleep();
+      tenths++;
+    }
+  }
+  return tenths;
+}
@@ -0,0 +1,54 @@
+/*
+
+ Crazy Clock host stubs
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The parts of base.c that the harnesses without a timer - test.c, fuzz.c
+ * and fleet.c - all stand in for the same way. Each of them supplies
+ * doTick(), doSleep() and q_random() itself.
+ *
+ * addTask() adds to whichever task list host_tasks points at, and
+ * host_run_tasks() runs that list's tasks that are due, as if a tenth had
+ * gone by. There's no timer, so every task has time to run. fleet.c points
+ * host_tasks at the running instance's own list.
+ *
+ * doTickBurst() is base.c's fallback for the builds without a second
+ * compare: doTick()s, with the spacing rounded to whole tenths.
+ */
+
+#ifndef HOSTSTUBS_H
+#define HOSTSTUBS_H
+
+#define HOST_MAX_TASKS (6) // as in base.c
+
+struct host_task {
+  void (*run)();
+  unsigned long period, countdown;
+};
+
+struct host_tasks {
+  unsigned char count;
+  struct host_task task[HOST_MAX_TASKS];
+};
+
+extern struct host_tasks *host_tasks;
+
+void host_run_tasks(void);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+
+ Crazy Clock host tick trace
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and whatever clock it's linked with in the host simulator
+ * and writes out the tick trace that avrsim.c writes for the real image: one
+ * line per tick, with the tenth-of-a-second it started in and which coil pin
+ * it was. The EEPROM starts out the same way avrsim sets it up.
+ *
+ * usage: hosttrace-TYPE [days] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hostsim.h"
+
+#define CYCLES_PER_TENTH (3276.8)
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  if (start + length > host_stop) return; // avrsim won't see it finish
+  // PB0/PB1 on the tiny45, PA5/PA6 on the tiny44, PA2/PA3 on the 1-series.
+  int pin = (pins & 0x4a) ? 1 : 0;
+  printf("%lu %d\n", (unsigned long)(start / CYCLES_PER_TENTH + 0.5), pin);
+}
+
+int main(int argc, char **argv) {
+  double days = argc > 1 ? atof(argv[1]) : 1;
+  uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 0x12345678;
+  memcpy(host_eeprom, &seed, sizeof(seed));
+  host_eeprom[4] = host_eeprom[5] = 0;
+  host_pulse = pulse;
+  host_stop = (uint64_t)(days * 86400 * 32768);
+  host_run();
+  return 0;
+}
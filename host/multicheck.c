@@ -0,0 +1,95 @@
+/*
+
+ Crazy Clock multi-movement check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and multi.c, built for an ATtiny44 with four movements,
+ * in the host simulator for a few days. No two coils may ever be driven at
+ * once, no tenth may have more pulses than fit, every movement's polarity
+ * must alternate, and every movement must keep time.
+ */
+
+#include <stdio.h>
+
+#include "hostsim.h"
+
+#define DAYS (3)
+#define MOVEMENTS (4)
+#define PULSES_PER_TENTH (2)
+#define CYCLES_PER_TENTH (3276.8)
+
+// Which movement, and which side of its coil, each PORTA bit is.
+static const int movement_of[8] = { 1, 1, 2, 2, 3, 0, 0, 3 };
+static const int side_of[8] = { 0, 1, 0, 1, 0, 0, 1, 1 };
+
+static unsigned long ticks[MOVEMENTS];
+static int last_side[MOVEMENTS] = { -1, -1, -1, -1 };
+static unsigned long tenth = ~0UL;
+static int in_tenth, most_in_tenth;
+static unsigned long late;
+static int failed;
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  if (pins & (pins - 1)) {
+    printf("FAIL: pins %02x driven at once at cycle %llu\n", pins, (unsigned long long)start);
+    failed = 1;
+    return;
+  }
+  int bit = __builtin_ctz(pins);
+  int m = movement_of[bit];
+  if (side_of[bit] == last_side[m]) {
+    printf("FAIL: movement %d got the same polarity twice at cycle %llu\n", m, (unsigned long long)start);
+    failed = 1;
+  }
+  last_side[m] = side_of[bit];
+  ticks[m]++;
+  unsigned long t = (unsigned long)(start / CYCLES_PER_TENTH);
+  if (t != tenth) {
+    tenth = t;
+    in_tenth = 0;
+  }
+  if (++in_tenth > most_in_tenth) most_in_tenth = in_tenth;
+  if (in_tenth > 1) late++;
+}
+
+int main() {
+  host_pulse = pulse;
+  host_stop = DAYS * 86400ULL * 32768;
+  host_run();
+
+  printf("%lu interrupts, %lu while awake, at most %d pulses in a tenth, %lu put off\n",
+    host_isr_count, host_isr_awake, most_in_tenth, late);
+  for(int i = 0; i < MOVEMENTS; i++) {
+    printf("movement %d: %lu ticks\n", i, ticks[i]);
+    // Any of them may be partway through a second at the end.
+    if (ticks[i] + 2 < DAYS * 86400UL || ticks[i] > DAYS * 86400UL + 1) {
+      printf("FAIL: movement %d should have ticked %lu times\n", i, DAYS * 86400UL);
+      failed = 1;
+    }
+  }
+  if (most_in_tenth > PULSES_PER_TENTH) {
+    printf("FAIL: more than %d pulses in one tenth\n", PULSES_PER_TENTH);
+    failed = 1;
+  }
+  if (host_isr_awake) {
+    printf("FAIL: the pulses made the clock work through interrupts\n");
+    failed = 1;
+  }
+  return failed;
+}
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock new moon table generator
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# This works out the times of the real new moons (Meeus, Astronomical
+# Algorithms, chapter 49 - good to a minute or so) and writes newmoon.h for
+# lunar-ephemeris.c.
+#
+# The table doesn't hold the times themselves. Each entry is how far that
+# new moon is from where a steady, mean-length month would put it, in units
+# of UNIT tenths-of-a-second. The steady schedule is picked so that all of
+# them fit in a signed char. Since every entry is measured from the same
+# schedule, the rounding never adds up - a month's length is off by one unit
+# at most.
+#
+# With --check, it reads the table back, runs the same integer arithmetic
+# the clock does, and compares the hand against the real new and full moons
+# for every month in the table. It fails if any new moon is off by more than
+# one unit, and shows how much better that is than lunar.c's steady rate.
+#
+# With --when, it shows which table entry is the first new moon after the
+# given date, and when it is, so you can build the clock with -DLUNATION=n.
+#
+# usage: newmoon.py [--first YEAR] [--years N] > newmoon.h
+#        newmoon.py --check newmoon.h
+#        newmoon.py --when YYYY-MM-DD [newmoon.h]
+
+import argparse
+import datetime
+import math
+import re
+import sys
+
+# A mean synodic month, to the nearest tenth of a second.
+MEAN = 25514429
+# The table's unit: 8 minutes, in tenths.
+UNIT = 4800
+# 12 hours of ticking each month.
+TICKS = 43200
+
+EPOCH_JD = 2440587.5 # 1970-01-01 00:00 UTC
+
+# A handful of published new moons (UTC), to make sure the algorithm is
+# right before trusting it for the rest.
+KNOWN = [
+  "2017-08-21 18:30",
+  "2019-07-02 19:16",
+  "2020-01-24 21:42",
+  "2023-04-20 04:12",
+  "2024-04-08 18:21",
+]
+
+def delta_t(year):
+  # TT - UT in seconds. The NASA eclipse pages' polynomials.
+  if year < 2050:
+    t = year - 2000
+    return 62.92 + 0.32217 * t + 0.005589 * t * t
+  u = (year - 1820) / 100
+  return -20 + 32 * u * u - 0.5628 * (2150 - year)
+
+def phase_jde(k, full):
+  # Meeus 49.1 and the corrections in table 49.A.
+  if full: k += 0.5
+  T = k / 1236.85
+  jde = (2451550.09766 + 29.530588861 * k + 0.00015437 * T**2
+    - 0.000000150 * T**3 + 0.00000000073 * T**4)
+  E = 1 - 0.002516 * T - 0.0000074 * T**2
+  r = math.radians
+  M = r(2.5534 + 29.10535670 * k - 0.0000014 * T**2 - 0.00000011 * T**3)
+  Mp = r(201.5643 + 385.81693528 * k + 0.0107582 * T**2 + 0.00001238 * T**3
+    - 0.000000058 * T**4)
+  F = r(160.7108 + 390.67050284 * k - 0.0016118 * T**2 - 0.00000227 * T**3
+    + 0.000000011 * T**4)
+  O = r(124.7746 - 1.56375588 * k + 0.0020672 * T**2 + 0.00000215 * T**3)
+  s = math.sin
+  if full:
+    c = [-0.40614, 0.17302, 0.01614, 0.01043, 0.00734, -0.00515, 0.00209]
+  else:
+    c = [-0.40720, 0.17241, 0.01608, 0.01039, 0.00739, -0.00514, 0.00208]
+  corr = (c[0] * s(Mp) + c[1] * E * s(M) + c[2] * s(2 * Mp) + c[3] * s(2 * F)
+    + c[4] * E * s(Mp - M) + c[5] * E * s(Mp + M) + c[6] * E * E * s(2 * M)
+    - 0.00111 * s(Mp - 2 * F) - 0.00057 * s(Mp + 2 * F)
+    + 0.00056 * E * s(2 * Mp + M) - 0.00042 * s(3 * Mp)
+    + 0.00042 * E * s(M + 2 * F) + 0.00038 * E * s(M - 2 * F)
+    - 0.00024 * E * s(2 * Mp - M) - 0.00017 * s(O)
+    - 0.00007 * s(Mp + 2 * M) + 0.00004 * s(2 * Mp - 2 * F)
+    + 0.00004 * s(3 * M) + 0.00003 * s(Mp + M - 2 * F)
+    + 0.00003 * s(2 * Mp + 2 * F) - 0.00003 * s(Mp + M + 2 * F)
+    + 0.00003 * s(Mp - M + 2 * F) - 0.00002 * s(Mp - M - 2 * F)
+    - 0.00002 * s(3 * Mp + M) + 0.00002 * s(4 * Mp))
+  extra = [
+    (0.000325, 299.77 + 0.107408 * k - 0.009173 * T**2),
+    (0.000165, 251.88 + 0.016321 * k),
+    (0.000164, 251.83 + 26.651886 * k),
+    (0.000126, 349.42 + 36.412478 * k),
+    (0.000110, 84.66 + 18.206239 * k),
+    (0.000062, 141.74 + 53.303771 * k),
+    (0.000060, 207.14 + 2.453732 * k),
+    (0.000056, 154.84 + 7.306860 * k),
+    (0.000047, 34.52 + 27.261239 * k),
+    (0.000042, 207.19 + 0.121824 * k),
+    (0.000040, 291.34 + 1.844379 * k),
+    (0.000037, 161.72 + 24.198154 * k),
+    (0.000035, 239.56 + 25.513099 * k),
+    (0.000023, 331.55 + 3.592518 * k),
+  ]
+  return jde + corr + sum(a * s(r(b)) for a, b in extra)
+
+def moon_time(k, full=False):
+  # Seconds since 1970, UTC.
+  jde = phase_jde(k, full)
+  year = 2000 + (jde - 2451545.0) / 365.25
+  return (jde - EPOCH_JD) * 86400 - delta_t(year)
+
+def unix(when):
+  return datetime.datetime.strptime(when, "%Y-%m-%d %H:%M").replace(tzinfo=datetime.timezone.utc).timestamp()
+
+def utc(seconds):
+  return datetime.datetime.fromtimestamp(seconds, datetime.timezone.utc).strftime("%Y-%m-%d %H:%M")
+
+def first_k(year):
+  # The first new moon on or after January 1 of the year.
+  start = unix("%d-01-01 00:00" % year)
+  k = math.floor((year - 2000) * 12.3685) - 1
+  while moon_time(k) < start: k += 1
+  return k
+
+def sanity():
+  for when in KNOWN:
+    t = unix(when)
+    k = round((t - moon_time(0)) / (MEAN / 10))
+    if abs(moon_time(k) - t) > 120:
+      sys.exit("new moon of %s comes out as %s" % (when, utc(moon_time(k))))
+
+def generate(first_year, years):
+  sanity()
+  k0 = first_k(first_year)
+  end = unix("%d-01-01 00:00" % (first_year + years))
+  first = moon_time(k0)
+  misses = []
+  k = k0
+  while moon_time(k) < end:
+    misses.append((moon_time(k) - first) * 10 - (k - k0) * MEAN)
+    k += 1
+  # Center the steady schedule on the real one.
+  middle = (min(misses) + max(misses)) / 2
+  epoch = first + middle / 10
+  offsets = [round((m - middle) / UNIT) for m in misses]
+  if max(abs(o) for o in offsets) > 127:
+    sys.exit("the offsets don't fit in a signed char")
+  print("// Generated by host/newmoon.py - don't edit.")
+  print("//")
+  print("// New moons from %s UTC (entry 0) through %d. Entry n is how far" % (utc(first), first_year + years - 1))
+  print("// that new moon is from NEWMOON_EPOCH plus n mean months, in units of")
+  print("// NEWMOON_UNIT tenths-of-a-second.")
+  print()
+  print("#define NEWMOON_EPOCH (%dL) // seconds since 1970 (UTC)" % round(epoch))
+  print("#define MEAN_LUNATION (%dL) // tenths-of-a-second" % MEAN)
+  print("#define NEWMOON_UNIT (%d) // 8 minutes" % UNIT)
+  print("#define NEWMOON_COUNT (%d)" % len(offsets))
+  print()
+  print("PROGMEM const signed char newmoon_offset[NEWMOON_COUNT] = {")
+  for i in range(0, len(offsets), 16):
+    print("  " + " ".join("%d," % o for o in offsets[i:i + 16]))
+  print("};")
+
+def read_table(file):
+  text = open(file).read()
+  defs = dict((m.group(1), int(m.group(2))) for m in re.finditer(r"#define (\w+) \((-?\d+)L?\)", text))
+  body = text[text.index("{") + 1:text.index("}")]
+  offsets = [int(x) for x in body.replace(",", " ").split()]
+  if defs["MEAN_LUNATION"] != MEAN or defs["NEWMOON_UNIT"] != UNIT or defs["NEWMOON_COUNT"] != len(offsets):
+    sys.exit("%s doesn't match this generator" % file)
+  return defs["NEWMOON_EPOCH"], offsets
+
+def check(file):
+  sanity()
+  epoch, offsets = read_table(file)
+  # Start the clock at the real new moon of entry 0.
+  epoch = epoch + offsets[0] * UNIT / 10
+  k0 = round((epoch - moon_time(0)) / (MEAN / 10))
+  if abs(moon_time(k0) - epoch) > UNIT / 20 + 1:
+    sys.exit("%s: entry 0 isn't a new moon" % file)
+  epoch = moon_time(k0)
+  worst_new = worst_full = worst_steady = 0
+  start = 0 # tenths since entry 0, by the clock's reckoning
+  for i in range(len(offsets) - 1):
+    # This is the clock's arithmetic, from lunar-ephemeris.c.
+    length = MEAN + (offsets[i + 1] - offsets[i]) * UNIT
+    whole, extra = divmod(length, TICKS)
+    # Where the clock thinks the new moon is, against where it is.
+    worst_new = max(worst_new, abs(epoch + start / 10 - moon_time(k0 + i)))
+    # Where the hand is at the real full moon. Bresenham, just like the clock:
+    # tick n is at n * whole + floor(n * extra / TICKS) tenths.
+    full = (moon_time(k0 + i, True) - epoch) * 10 - start
+    lo, hi = 0, TICKS
+    while lo < hi:
+      mid = (lo + hi + 1) // 2
+      if mid * whole + mid * extra // TICKS <= full: lo = mid
+      else: hi = mid - 1
+    n = lo
+    # The hand should be at 6 o'clock. Convert the miss to time.
+    worst_full = max(worst_full, abs(n - TICKS / 2) * length / TICKS / 10)
+    # lunar.c's steady rate, started at entry 0.
+    steady = (moon_time(k0 + i) - epoch) % (MEAN / 10)
+    worst_steady = max(worst_steady, min(steady, MEAN / 10 - steady))
+    start += length
+  print("%s: %d new moons from %s" % (file, len(offsets), utc(epoch)))
+  print("worst new moon %.1f minutes off, worst full moon %.1f hours off" % (worst_new / 60, worst_full / 3600))
+  print("a steady rate would be up to %.1f hours off at new moon" % (worst_steady / 3600))
+  # Half a unit at either end, plus the rounding of the epoch.
+  if worst_new > UNIT / 10 + 1:
+    print("FAIL: the table is off by more than its rounding")
+    return 1
+  return 0
+
+def when(date, file):
+  epoch, offsets = read_table(file)
+  t = unix(date + " 00:00")
+  for i in range(len(offsets)):
+    at = epoch + (i * MEAN + offsets[i] * UNIT) / 10
+    if at >= t:
+      print("-DLUNATION=%d: the new moon of %s UTC" % (i, utc(at)))
+      return 0
+  print("%s is past the end of %s" % (date, file))
+  return 1
+
+def main():
+  parser = argparse.ArgumentParser(description="Generate or check the new moon table.")
+  parser.add_argument("--first", type=int, default=2020, help="first year of the table")
+  parser.add_argument("--years", type=int, default=50, help="how many years it covers")
+  parser.add_argument("--check", metavar="TABLE", help="check a generated table")
+  parser.add_argument("--when", metavar="DATE", help="find the first table entry after the date")
+  parser.add_argument("table", nargs="?", default="../newmoon.h")
+  args = parser.parse_args()
+  if args.check:
+    sys.exit(check(args.check))
+  if args.when:
+    sys.exit(when(args.when, args.table))
+  generate(args.first, args.years)
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,90 @@
+/*
+
+ Crazy Clock overrun stress test
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs the real base.c and a clock through the host simulator, and
+ * every so often pretends that the clock code took far too long - anywhere
+ * from a fraction of a tenth to a whole minute. The catch-up logic in
+ * doSleep() should make all of that up, so at the end the clock must have
+ * ticked exactly once for every 10 interrupts. The overrun telemetry must
+ * agree with what the simulator saw, and must have made it into EEPROM.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hostsim.h"
+
+#define CYCLES_PER_TENTH (3276.8)
+#define DAYS (2)
+#define DAY_CYCLES (86400ULL * 32768)
+
+extern unsigned int overrun_max;
+extern unsigned long overrun_total;
+
+static unsigned long ticks;
+static unsigned long rng = 1;
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  ticks++;
+}
+
+static uint64_t work(void) {
+  // Leave the last hour alone, so the clock has caught up when we stop.
+  if (host_cycles > host_stop - 3600ULL * 32768) return 0;
+  // Once, a whole minute.
+  if (host_cycles > DAY_CYCLES / 2 && overrun_max < 600) return 60 * 32768;
+  rng = rng * 1103515245 + 12345;
+  if ((rng >> 16) % 500) return 0;
+  // Anywhere from nothing to 4 tenths.
+  return (rng >> 8) % (uint64_t)(4 * CYCLES_PER_TENTH);
+}
+
+int main() {
+  int failed = 0;
+  host_pulse = pulse;
+  host_work = work;
+  host_stop = DAYS * DAY_CYCLES;
+  host_run();
+
+  unsigned long expected = host_isr_count / 10;
+  printf("%lu interrupts, %lu ticks, %lu overrun (max %u)\n", host_isr_count, ticks, overrun_total, overrun_max);
+  if (ticks + 1 < expected || ticks > expected + 1) {
+    printf("FAIL: expected %lu ticks\n", expected);
+    failed = 1;
+  }
+  if (overrun_total != host_isr_awake) {
+    printf("FAIL: the simulator saw %lu interrupts while awake\n", host_isr_awake);
+    failed = 1;
+  }
+  if (overrun_max < 600) {
+    printf("FAIL: the minute-long overrun wasn't recorded\n");
+    failed = 1;
+  }
+  uint16_t ee_max;
+  uint32_t ee_total;
+  memcpy(&ee_max, host_eeprom + 8, sizeof(ee_max));
+  memcpy(&ee_total, host_eeprom + 10, sizeof(ee_total));
+  if (ee_max == 0xffff || ee_total == 0xffffffff || ee_total == 0 || ee_total > overrun_total || ee_max > overrun_max) {
+    printf("FAIL: EEPROM has max %u, total %lu\n", ee_max, (unsigned long)ee_total);
+    failed = 1;
+  }
+  return failed;
+}
@@ -0,0 +1,170 @@
+/*
+
+ Crazy Clock reference discipline check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and normal.c, built with PPS_DISCIPLINE, in the host
+ * simulator for a few days, with a crystal whose error wanders - a daily
+ * temperature swing on top of a steady offset, and aging - and a reference
+ * pulse once a true second, with some jitter. Partway through, the reference
+ * goes away for a few hours.
+ *
+ * Each tick starts a second of the clock's time, so the true time it
+ * happens at says how far off the hand is. Once the loop has settled, that
+ * mustn't move by more than a few timer counts while the reference is there,
+ * and not by much more while it's gone.
+ *
+ * The crystal's error isn't constant, so this works out real time itself
+ * rather than with host_ppm.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <avr/io.h>
+#include "hostsim.h"
+
+#define DAYS (3)
+#define SECONDS (DAYS * 86400)
+#define PPM (15.0)
+#define PPM_SWING (3.0) // either way, once a day
+#define PPM_AGING (0.5) // a day
+// The edges come this far into each true second, give or take the jitter.
+#define PPS_PHASE (0.3)
+#define JITTER (0.001)
+// How long the loop gets to lock on, at the start and after the outage.
+#define SETTLE (6 * 3600)
+#define OUTAGE_START (36 * 3600)
+#define OUTAGE_END (40 * 3600)
+// How far the hand may move from where it settled, in seconds.
+#define LOCKED_LIMIT (0.010)
+#define HOLDOVER_LIMIT (0.100)
+
+extern volatile unsigned long trim_cycles;
+extern volatile char trim_offset;
+extern unsigned long overrun_total;
+
+// The crystal cycle at the start of each true second.
+static double cycle_at[SECONDS + 2];
+
+static double ppm(double t) {
+  return PPM + PPM_SWING * sin(2 * M_PI * t / 86400) + PPM_AGING * t / 86400;
+}
+
+static void buildCrystal() {
+  cycle_at[0] = 0;
+  for(long k = 0; k <= SECONDS; k++)
+    cycle_at[k + 1] = cycle_at[k] + 32768.0 * (1 + ppm(k + 0.5) / 1e6);
+}
+
+static double cycleAt(double t) {
+  long k = (long)t;
+  if (k > SECONDS) k = SECONDS;
+  return cycle_at[k] + (t - k) * (cycle_at[k + 1] - cycle_at[k]);
+}
+
+// The true time at the given cycle.
+static double trueTime(uint64_t cycles) {
+  long lo = 0, hi = SECONDS;
+  while(lo < hi) {
+    long mid = (lo + hi + 1) / 2;
+    if (cycle_at[mid] <= cycles) lo = mid; else hi = mid - 1;
+  }
+  return lo + (cycles - cycle_at[lo]) / (cycle_at[lo + 1] - cycle_at[lo]);
+}
+
+// The same jitter for the same edge, every time it's asked for.
+static double jitter(long k) {
+  uint32_t x = (uint32_t)k * 2654435761U;
+  x ^= x >> 15;
+  x *= 2246822519U;
+  x ^= x >> 13;
+  return JITTER * (2.0 * x / 4294967295.0 - 1);
+}
+
+static uint64_t edge(uint64_t after) {
+  for(long k = trueTime(after) - 1; k < 0 || k <= SECONDS; k++) {
+    if (k < 0 || (k >= OUTAGE_START && k < OUTAGE_END)) continue;
+    double c = cycleAt(k + PPS_PHASE + jitter(k));
+    if (c >= after) return (uint64_t)ceil(c);
+  }
+  return UINT64_MAX;
+}
+
+static long ticks;
+static double settled, worst_locked, worst_holdover, relocked, worst_relocked;
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  // PB2 idles high, with its pull-up.
+  if (!(pins & (_BV(PORTB0) | _BV(PORTB1)))) return;
+  static uint64_t last_end;
+  uint64_t was = last_end;
+  last_end = start + length;
+  if (start == was) return; // the same pulse, a ms later
+  double t = trueTime(start);
+  // Positive means the hand is behind.
+  double offset = t - ticks++;
+  if (t < SETTLE) {
+    settled = offset;
+  } else if (t < OUTAGE_START) {
+    if (fabs(offset - settled) > worst_locked) worst_locked = fabs(offset - settled);
+  } else if (t < OUTAGE_END) {
+    if (fabs(offset - settled) > worst_holdover) worst_holdover = fabs(offset - settled);
+  } else if (t < OUTAGE_END + SETTLE) {
+    relocked = offset;
+  } else {
+    if (fabs(offset - relocked) > worst_relocked) worst_relocked = fabs(offset - relocked);
+  }
+}
+
+static int check(void) {
+  int failed = 0;
+  double trim = trim_cycles ? trim_offset * 1e7 / trim_cycles / 10 : 0;
+  printf("%ld ticks, %lu overruns, crystal %.2f ppm fast, trim %.2f ppm\n", ticks, overrun_total,
+    ppm(SECONDS), trim);
+  printf("the hand moved %.1f ms locked, %.1f ms in a %d hour outage, %.1f ms locked again\n",
+    worst_locked * 1000, worst_holdover * 1000, (OUTAGE_END - OUTAGE_START) / 3600, worst_relocked * 1000);
+  if (worst_locked > LOCKED_LIMIT || worst_relocked > LOCKED_LIMIT) {
+    printf("FAIL: it should have stayed within %.0f ms of the reference\n", LOCKED_LIMIT * 1000);
+    failed = 1;
+  }
+  if (worst_holdover > HOLDOVER_LIMIT) {
+    printf("FAIL: without the reference, it should have kept within %.0f ms\n", HOLDOVER_LIMIT * 1000);
+    failed = 1;
+  }
+  if (overrun_total != 0) {
+    printf("FAIL: the clock code overran\n");
+    failed = 1;
+  }
+  if (host_isr_awake != 0) {
+    printf("FAIL: %lu timer interrupts came while awake\n", host_isr_awake);
+    failed = 1;
+  }
+  return failed;
+}
+
+int main() {
+  buildCrystal();
+  host_eeprom[4] = host_eeprom[5] = 0; // no factory trim
+  host_pulse = pulse;
+  host_int0 = edge;
+  host_stop = (uint64_t)cycle_at[SECONDS];
+  return host_boot(check) != 0;
+}
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock RAM report
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# This reads the linker maps of the clock images and says where their RAM
+# goes: .data (which on the AVR includes .rodata - constant strings and
+# tables not in PROGMEM) and .bss, by object file, and what's left over for
+# the stack. 'avrsim -r' says how deep the stack actually gets, and a
+# STACK_PAINT build records it in EEPROM. See the README.
+#
+# usage: ramreport.py [--sram BYTES] TYPE.map...
+
+import argparse
+import os
+import re
+import sys
+
+OUTPUT = re.compile(r'^(\.\S+)')
+INPUT = re.compile(r'^ (\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*))?$')
+PLACED = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+RAM = ('.data', '.bss', '.noinit')
+
+
+def owner(path):
+    name = os.path.basename(path)
+    m = re.match(r'.*\((.*)\)$', name)
+    if m:
+        # A library member, like libgcc.a(_mulsi3.o).
+        return re.sub(r'\(.*', '', name)
+    return name
+
+
+def parse(path):
+    """The RAM bytes in each output section, by object file."""
+    usage = {}
+    section = None
+    pending = None
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip('\n')
+            m = OUTPUT.match(line)
+            if m:
+                section = m.group(1) if m.group(1) in RAM else None
+                pending = None
+                continue
+            if section is None:
+                continue
+            m = INPUT.match(line)
+            if m and not m.group(1).startswith('*') and not m.group(1).startswith('0x'):
+                if m.group(2) is None:
+                    # The name was too long, so the rest is on the next line.
+                    pending = m.group(1)
+                    continue
+                size, obj = int(m.group(3), 16), m.group(4)
+            elif pending:
+                m = PLACED.match(line)
+                pending = None
+                if not m:
+                    continue
+                size, obj = int(m.group(2), 16), m.group(3)
+            else:
+                continue
+            if size == 0 or obj.startswith('load address'):
+                continue
+            key = owner(obj.strip())
+            by_obj = usage.setdefault(section, {})
+            by_obj[key] = by_obj.get(key, 0) + size
+    return usage
+
+
+def main():
+    parser = argparse.ArgumentParser(description='RAM use per clock type, from the linker maps')
+    parser.add_argument('--sram', type=int, default=256, help='bytes of SRAM on the chip')
+    parser.add_argument('maps', nargs='+')
+    args = parser.parse_args()
+
+    for path in args.maps:
+        name = os.path.splitext(os.path.basename(path))[0]
+        usage = parse(path)
+        totals = {s: sum(usage.get(s, {}).values()) for s in RAM}
+        used = sum(totals.values())
+        print('%s: .data %d, .bss %d%s - %d of %d bytes left for the stack' % (
+            name, totals['.data'], totals['.bss'],
+            ', .noinit %d' % totals['.noinit'] if totals['.noinit'] else '',
+            args.sram - used, args.sram))
+        objs = sorted(set(o for s in RAM for o in usage.get(s, {})))
+        for obj in objs:
+            print('  %-20s %s' % (obj, '  '.join('%s %3d' % (s, usage.get(s, {}).get(obj, 0))
+                for s in RAM if totals[s])))
+        if used > args.sram:
+            print('%s: the static variables don\'t fit' % name, file=sys.stderr)
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,135 @@
+/*
+
+ Crazy Clock rate engine check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs one of the clocks built on rate.h for a few weeks of tenths,
+ * the way fuzz.c does - doTick() and doSleep() just count - and checks that
+ * its books come out exactly, and that it changes speed smoothly.
+ *
+ * A clock with a fixed cycle (CYCLE_TENTHS) must tick exactly CYCLE_TICKS
+ * times in every one, so it can never wander. Otherwise, the hand must stay
+ * between BEHIND and AHEAD tenths of true time, and come back to it at least
+ * once a day. And for every clock, the gap between one tick and the next
+ * mustn't differ from the one before by more than a tenth.
+ *
+ * The Makefile gives each clock type its figures.
+ */
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DAYS (30)
+#define TENTHS_PER_DAY (864000L)
+#define M (0x7fffffffL)
+
+#ifndef CYCLE_TENTHS
+#define CYCLE_TENTHS (0)
+#define CYCLE_TICKS (0)
+#endif
+#ifndef AHEAD
+#define AHEAD (TENTHS_PER_DAY * DAYS)
+#endif
+#ifndef BEHIND
+#define BEHIND (TENTHS_PER_DAY * DAYS)
+#endif
+
+extern void loop();
+
+static int32_t seed = 0x12345678;
+static long tenth, ticks, last_tick = -1, last_gap = -1, cycle_ticks;
+static long ahead, behind, worst_step, bad_cycles;
+static unsigned long returns; // a bit for each day the hand was on time
+static jmp_buf done;
+
+// The same generator as base.c.
+unsigned long q_random() {
+  seed = (seed >> 16) + ((seed << 15) & M) - (seed >> 21) - ((seed << 10) & M);
+  if (seed < 0) seed += M;
+  return (unsigned long)seed;
+}
+
+void addTask(void (*run)(), unsigned long period, unsigned char cost) { }
+
+static void endTenth(int tick) {
+  if (tick) {
+    if (last_tick >= 0) {
+      long gap = tenth - last_tick;
+      if (last_gap >= 0 && labs(gap - last_gap) > worst_step) worst_step = labs(gap - last_gap);
+      last_gap = gap;
+    }
+    last_tick = tenth;
+    ticks++;
+    cycle_ticks++;
+  }
+  // How far the hand is from true time, right after this tenth. A tick on
+  // time puts it 9 tenths ahead, and it's 0 just before the next.
+  long offset = ticks * 10 - (tenth + 1);
+  if (offset - 9 > ahead) ahead = offset - 9;
+  if (-offset > behind) behind = -offset;
+  if (tick && offset == 9) returns |= 1UL << (tenth / TENTHS_PER_DAY);
+  tenth++;
+#if CYCLE_TENTHS
+  if (tenth % CYCLE_TENTHS == 0) {
+    if (cycle_ticks != CYCLE_TICKS && bad_cycles++ == 0)
+      printf("FAIL: %ld ticks in the cycle ending at tenth %ld, not %ld\n", cycle_ticks, tenth, (long)CYCLE_TICKS);
+    cycle_ticks = 0;
+  }
+#endif
+  if (tenth >= TENTHS_PER_DAY * DAYS) longjmp(done, 1);
+}
+
+void doSleep() {
+  endTenth(0);
+}
+
+void doTick() {
+  endTenth(1);
+}
+
+int main() {
+  int failed = 0;
+  if (!setjmp(done)) {
+    while(1) loop();
+  }
+  printf("%d days: %ld ticks, up to %.1f s ahead and %.1f s behind, gaps change by up to %ld tenths\n",
+    DAYS, ticks, ahead / 10.0, behind / 10.0, worst_step);
+  if (bad_cycles) {
+    printf("FAIL: %ld cycles had the wrong number of ticks\n", bad_cycles);
+    failed = 1;
+  }
+  // A clock with a cycle needn't ever be exactly on time.
+  int missed = 0;
+  for(int day = 0; day < DAYS; day++) if (!(returns & 1UL << day)) missed++;
+  if (!CYCLE_TENTHS && missed) {
+    printf("FAIL: on %d days, the hand was never back on time\n", missed);
+    failed = 1;
+  }
+  if (ahead > AHEAD || behind > BEHIND) {
+    printf("FAIL: it should stay within %.1f s ahead and %.1f s behind\n", AHEAD / 10.0, BEHIND / 10.0);
+    failed = 1;
+  }
+  if (worst_step > 1) {
+    printf("FAIL: the speed should change smoothly\n");
+    failed = 1;
+  }
+  return failed;
+}
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock rhythm compiler
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# This writes songs.h for tuney.c from the rhythms in songs.txt. Each song is
+# a name, a title, and either a beat (in seconds) with how many beats there
+# are from each note to the next, or a MIDI file, whose note onsets are used
+# (chords are one note). The onsets are rounded to the nearest tenth - from
+# the start of the song, so the rounding never adds up.
+#
+# A song has to take exactly a second per tick, so that the clock doesn't
+# drift. The table holds the pause before the song (the lead-in) and the
+# pauses between its ticks, two to a byte, but not the pause after it. tuney.c
+# works that out as it goes: whatever's left of a second per tick. The
+# lead-in can be given in tenths. Otherwise it's half of the time the song has
+# to spare.
+#
+# With --check, it plays each song in the table back with the same integer
+# arithmetic tuney.c uses, and fails if any of them doesn't take a second per
+# tick, or has no room for its lead-in or lead-out. It also fails if the table
+# isn't what songs.txt compiles to.
+#
+# With --onsets, it just prints a MIDI file's onsets, in seconds, as
+# fractions. 'make check' compares testsong.mid's with testsong.onsets.
+#
+# usage: rhythm.py [songs.txt] > songs.h
+#        rhythm.py --check songs.h [songs.txt]
+#        rhythm.py --onsets file.mid
+
+import argparse
+import fractions
+import os
+import re
+import struct
+import sys
+
+# From base.h.
+IRQS_PER_SECOND = 10
+# A pause between ticks of the rhythm has to fit in 4 bits, and 0 ends the song.
+MAX_PAUSE = 15
+MAX_LEAD_IN = 255
+
+SONGS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "songs.txt")
+
+class Song:
+  def __init__(self, name, title):
+    self.name = name
+    self.title = title
+    self.beat = None
+    self.beats = None
+    self.midi = None
+    self.lead_in = None
+
+def fail(where, message):
+  sys.exit("%s: %s" % (where, message))
+
+def read_songs(path):
+  songs = []
+  for number, line in enumerate(open(path), 1):
+    where = "%s:%d" % (path, number)
+    line = line.split("#", 1)[0].strip()
+    if not line: continue
+    word, _, rest = line.partition(" ")
+    rest = rest.strip()
+    if word == "song":
+      name, _, title = rest.partition(" ")
+      if not re.match(r"^[a-z_][a-z0-9_]*$", name): fail(where, "a song name is lower case letters, digits and _")
+      if any(s.name == name for s in songs): fail(where, "there's already a song called %s" % name)
+      songs.append(Song(name, title.strip()))
+      continue
+    if not songs: fail(where, "'%s' before the first song" % word)
+    song = songs[-1]
+    try:
+      if word == "beat":
+        song.beat = fractions.Fraction(rest)
+      elif word == "rhythm":
+        song.beats = [fractions.Fraction(x) for x in rest.split()]
+      elif word == "midi":
+        song.midi = os.path.join(os.path.dirname(path), rest)
+      elif word == "lead-in":
+        song.lead_in = int(rest)
+      else:
+        fail(where, "don't know '%s'" % word)
+    except ValueError:
+      fail(where, "can't read '%s'" % rest)
+  for song in songs:
+    if (song.midi is None) == (song.beats is None):
+      fail(path, "%s needs a rhythm or a MIDI file" % song.name)
+    if song.beats is not None and (song.beat is None or song.beat <= 0):
+      fail(path, "%s needs a beat" % song.name)
+  return songs
+
+def varlen(data, i):
+  value = 0
+  while True:
+    b = data[i]
+    i += 1
+    value = (value << 7) | (b & 0x7f)
+    if not b & 0x80: return value, i
+
+def read_midi(path):
+  # The onset of every note, in seconds. Just enough of the Standard MIDI
+  # File format for that: note-ons and tempo changes, from every track.
+  data = open(path, "rb").read()
+  if data[:4] != b"MThd": fail(path, "not a MIDI file")
+  length, _, tracks, division = struct.unpack(">IHHH", data[4:14])
+  if division & 0x8000: fail(path, "SMPTE time isn't supported")
+  i = 8 + length
+  notes = []
+  tempos = [(0, 500000)] # microseconds a quarter note, until it's set
+  for _ in range(tracks):
+    if data[i:i + 4] != b"MTrk": fail(path, "a track is missing")
+    end = i + 8 + struct.unpack(">I", data[i + 4:i + 8])[0]
+    i += 8
+    at = 0
+    status = 0
+    while i < end:
+      delta, i = varlen(data, i)
+      at += delta
+      if data[i] & 0x80:
+        status = data[i]
+        i += 1
+      if status == 0xff:
+        kind = data[i]
+        length, i = varlen(data, i + 1)
+        if kind == 0x51: tempos.append((at, int.from_bytes(data[i:i + 3], "big")))
+        i += length
+      elif status in (0xf0, 0xf7):
+        length, i = varlen(data, i)
+        i += length
+      elif status & 0xe0 == 0xc0:
+        i += 1 # program change and channel pressure have one data byte
+      else:
+        if status & 0xf0 == 0x90 and data[i + 1] > 0: notes.append(at)
+        i += 2
+    i = end
+  tempos.sort(key=lambda t: t[0])
+  def seconds(tick):
+    t, last, tempo = fractions.Fraction(0), 0, tempos[0][1]
+    for change, new in tempos:
+      if change > tick: break
+      t += fractions.Fraction((change - last) * tempo, division * 1000000)
+      last, tempo = change, new
+    return t + fractions.Fraction((tick - last) * tempo, division * 1000000)
+  onsets = [seconds(n) for n in sorted(set(notes))]
+  if len(onsets) < 2: fail(path, "there has to be more than one note")
+  return [t - onsets[0] for t in onsets]
+
+def tenths(t):
+  # Round half up, so that it's the same everywhere.
+  return int(t * IRQS_PER_SECOND + fractions.Fraction(1, 2))
+
+def compile_song(song):
+  if song.midi is not None:
+    onsets = read_midi(song.midi)
+  else:
+    onsets = [fractions.Fraction(0)]
+    for b in song.beats: onsets.append(onsets[-1] + b * song.beat)
+  grid = [tenths(t) for t in onsets]
+  pauses = [b - a - 1 for a, b in zip(grid, grid[1:])]
+  for n, p in enumerate(pauses):
+    if p < 0: fail(song.name, "notes %d and %d land in the same tenth" % (n + 1, n + 2))
+    if p == 0: fail(song.name, "notes %d and %d are in back to back tenths, which the table can't hold" % (n + 1, n + 2))
+    if p > MAX_PAUSE: fail(song.name, "notes %d and %d are more than %.1f s apart" % (n + 1, n + 2, (MAX_PAUSE + 1) / 10))
+  # The song's ticks are the one before the lead-in, then one for each note.
+  spare = (IRQS_PER_SECOND - 1) * (len(pauses) + 2) - sum(pauses)
+  if spare < 2:
+    fail(song.name, "the song is too slow to keep time - it has %d tenths to spare for its lead-in and lead-out" % spare)
+  lead_in = song.lead_in if song.lead_in is not None else spare // 2
+  if lead_in < 1 or lead_in > MAX_LEAD_IN:
+    fail(song.name, "the lead-in has to be 1 to %d tenths" % MAX_LEAD_IN)
+  if spare - lead_in < 1:
+    fail(song.name, "a %d tenth lead-in leaves no lead-out - there are only %d tenths to spare" % (lead_in, spare))
+  return lead_in, pauses
+
+def pack(lead_in, pauses):
+  nibbles = pauses + [0]
+  if len(nibbles) & 1: nibbles.append(0)
+  return [lead_in] + [nibbles[i] | (nibbles[i + 1] << 4) for i in range(0, len(nibbles), 2)]
+
+def generate(path):
+  songs = read_songs(path)
+  table = []
+  starts = []
+  size = 0
+  for song in songs:
+    lead_in, pauses = compile_song(song)
+    if size > 255: fail(path, "song_start[] only reaches 256 bytes into the table")
+    starts.append(size)
+    table.append((song, lead_in, pauses, pack(lead_in, pauses)))
+    size += len(table[-1][3])
+  lines = []
+  lines.append("// Generated by host/rhythm.py from host/songs.txt - don't edit.")
+  lines.append("//")
+  lines.append("// Each song is its lead-in, in tenths, then the pauses between its ticks,")
+  lines.append("// low nibble first, ending with a 0. tuney.c works out the lead-out.")
+  lines.append("")
+  lines.append("#define SONG_COUNT (%d)" % len(table))
+  lines.append("")
+  lines.append("PROGMEM const unsigned char songs[%d] = {" % size)
+  for song, lead_in, pauses, packed in table:
+    ticks = len(pauses) + 2
+    lines.append("  // %s: %s - %d ticks, lead-in %d, lead-out %d" % (song.name, song.title, ticks,
+      lead_in, (IRQS_PER_SECOND - 1) * ticks - sum(pauses) - lead_in))
+    lines.append("  %d, %s" % (packed[0], " ".join("0x%02x," % b for b in packed[1:])))
+  lines.append("};")
+  lines.append("")
+  lines.append("PROGMEM const unsigned char song_start[SONG_COUNT] = { %s };" % ", ".join(str(s) for s in starts))
+  return "\n".join(lines) + "\n", table
+
+def numbers(text, name):
+  m = re.search(r"\b%s\[\w*\] = \{(.*?)\};" % name, text, re.S)
+  if not m: sys.exit("no %s[] table" % name)
+  body = re.sub(r"//.*", "", m.group(1))
+  return [int(x, 0) for x in body.replace(",", " ").split()]
+
+def check(path, songs_path):
+  text = open(path).read()
+  table = numbers(text, "songs")
+  starts = numbers(text, "song_start")
+  failed = False
+  for n, start in enumerate(starts):
+    # As tuney.c plays it.
+    at = start
+    pause = table[at]
+    at += 1
+    count = 0
+    owed = 0
+    ticks = 0
+    played = []
+    while True:
+      ticks += 1
+      owed += IRQS_PER_SECOND - 1 - pause
+      played.append(pause)
+      packed = table[at]
+      if count & 1:
+        pause = packed >> 4
+        at += 1
+      else:
+        pause = packed & 0xf
+      count += 1
+      if pause == 0: break
+    ticks += 1
+    lead_out = owed + IRQS_PER_SECOND - 1
+    played.append(max(lead_out, 0)) # a for loop can't sleep less than nothing
+    tenths_taken = ticks + sum(played)
+    print("song %d: %d ticks in %.1f s, lead-in %.1f s, lead-out %.1f s, %d bytes" % (n, ticks,
+      tenths_taken / 10, played[0] / 10, lead_out / 10, at - start + (count & 1)))
+    if tenths_taken != ticks * IRQS_PER_SECOND:
+      print("FAIL: song %d doesn't take a second a tick" % n)
+      failed = True
+    if played[0] < 1 or lead_out < 1:
+      print("FAIL: song %d runs into the ticks around it" % n)
+      failed = True
+  expected, _ = generate(songs_path)
+  if text != expected:
+    print("FAIL: %s isn't what %s compiles to" % (path, songs_path))
+    failed = True
+  return 1 if failed else 0
+
+def main():
+  parser = argparse.ArgumentParser(description="Compile tuney.c's songs")
+  parser.add_argument("--check", metavar="SONGS_H", help="check a table instead of writing one")
+  parser.add_argument("--onsets", metavar="MIDI", help="print a MIDI file's onsets instead")
+  parser.add_argument("songs", nargs="?", default=SONGS, help="the song descriptions")
+  args = parser.parse_args()
+  if args.onsets:
+    for t in read_midi(args.onsets): print(t)
+    return 0
+  if args.check:
+    return check(args.check, args.songs)
+  text, _ = generate(args.songs)
+  sys.stdout.write(text)
+  return 0
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,114 @@
+/*
+
+ Crazy Clock PRNG seed check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs the real base.c and whacky.c (which uses q_random() every second)
+ * in the host simulator, through several battery changes. It checks that
+ * q_random() produces exactly the stream that 32 bit AVR arithmetic would,
+ * that every battery change perturbs the stored seed, and that the seed is
+ * saved once a day.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hostsim.h"
+
+#define M (0x7fffffffL)
+
+extern unsigned long q_random();
+
+// The same generator, done with explicit 32 bit wraparound.
+static uint32_t reference(uint32_t seed) {
+  uint32_t s = (seed >> 16) + ((seed << 15) & M) - (seed >> 21) - ((seed << 10) & M);
+  if ((int32_t)s < 0) s += M;
+  return s;
+}
+
+static uint32_t eepromSeed() {
+  uint32_t seed;
+  memcpy(&seed, host_eeprom, sizeof(seed));
+  return seed;
+}
+
+static uint32_t boot_seed;
+
+// Is the PRNG somewhere shortly downstream of boot_seed? If so, does it
+// keep matching the reference for a good long while?
+static int checkStream(void) {
+  uint32_t value = q_random(), s = boot_seed;
+  int steps;
+  for(steps = 0; steps < 1000000 && s != value; steps++) s = reference(s);
+  if (s != value) {
+    printf("FAIL: q_random() isn't on the reference stream\n");
+    return 1;
+  }
+  for(long i = 0; i < 10000000; i++) {
+    value = q_random();
+    s = reference(s);
+    if (value != s || value == 0 || value > M) {
+      printf("FAIL: q_random() returned %lu, expected %lu\n", (unsigned long)value, (unsigned long)s);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int checkBoot(void) {
+  if (eepromSeed() != boot_seed) {
+    printf("FAIL: seed is %08lx, expected %08lx\n", (unsigned long)eepromSeed(), (unsigned long)boot_seed);
+    return 1;
+  }
+  return checkStream();
+}
+
+static int checkDaily(void) {
+  uint32_t s = boot_seed;
+  for(long i = 0; i < 100000 && s != eepromSeed(); i++) s = reference(s);
+  if (eepromSeed() == boot_seed || s != eepromSeed()) {
+    printf("FAIL: the seed wasn't saved during the day\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  int failed = 0;
+
+  // A blank EEPROM gets the default seed, perturbed once.
+  host_stop = host_crystal(60);
+  boot_seed = reference(0x12345678L);
+  if (host_boot(checkBoot) != 0) failed = 1;
+  printf("first boot: seed %08lx\n", (unsigned long)eepromSeed());
+
+  // Every battery change perturbs it again.
+  for(int i = 0; i < 3; i++) {
+    boot_seed = reference(eepromSeed());
+    if (host_boot(checkBoot) != 0) failed = 1;
+    printf("battery change: seed %08lx\n", (unsigned long)eepromSeed());
+  }
+
+  // And it's saved once a day while running.
+  host_stop = host_crystal(86400 + 60);
+  boot_seed = reference(eepromSeed());
+  if (host_boot(checkDaily) != 0) failed = 1;
+  printf("after a day: seed %08lx\n", (unsigned long)eepromSeed());
+  return failed;
+}
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock step pattern compiler
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# This writes steps.h for crazy.c from the speed pairs below. A speed is how
+# many times it ticks in STEP_SECONDS, and the tenth of the first tick. The
+# rest are spread evenly after it. Each one becomes a bit pattern, a bit a
+# tenth, low bit first, so crazy.c just shifts its way through them.
+#
+# crazy.c always runs both speeds of a pair for the same time, so a pair has
+# to tick twice as many times as the normal speed does, between the two of
+# them. To add a pair, add it to PAIRS and run 'make -C host steps'. The table
+# holds a power of two pairs, so that picking one doesn't need a division.
+#
+# With --check, it reads the patterns back out of the table, and fails if a
+# pair doesn't keep time, or a pattern doesn't fit, or if the table isn't
+# what PAIRS compiles to.
+#
+# usage: steps.py > steps.h
+#        steps.py --check steps.h
+
+import argparse
+import re
+import sys
+
+# From base.h.
+IRQS_PER_SECOND = 10
+# crazy.c changes step only every STEP_SECONDS, and picks steps of 12 to 36
+# seconds, so this has to divide 12 and 6 (and be whole seconds).
+STEP_SECONDS = 6
+STEP_TENTHS = STEP_SECONDS * IRQS_PER_SECOND
+STEP_BYTES = (STEP_TENTHS + 7) // 8
+NORMAL_TICKS = STEP_SECONDS
+
+# Each speed is (name, ticks in STEP_SECONDS, tenth of the first tick).
+PAIRS = [
+  (("slow", 2, 10), ("fast", 10, 0)), # a third and five thirds
+  (("normal", 6, 0), ("normal", 6, 0)),
+  (("half", 3, 0), ("half again", 9, 0)),
+  (("two thirds", 4, 0), ("four thirds", 8, 0)),
+]
+
+def fail(message):
+  sys.exit("steps.py: %s" % message)
+
+def pattern(name, ticks, first):
+  if ticks < 0 or ticks > STEP_TENTHS:
+    fail("%s has to tick 0 to %d times" % (name, STEP_TENTHS))
+  tenths = [first + i * STEP_TENTHS // ticks for i in range(ticks)]
+  if tenths and tenths[-1] >= STEP_TENTHS:
+    fail("%s's ticks don't fit in %d tenths after tenth %d" % (name, STEP_TENTHS, first))
+  bits = 0
+  for t in tenths: bits |= 1 << t
+  return bits
+
+def generate():
+  count = len(PAIRS)
+  if count & (count - 1): fail("there have to be a power of two pairs, not %d" % count)
+  for a, b in PAIRS:
+    if a[1] + b[1] != 2 * NORMAL_TICKS:
+      fail("%s and %s tick %d times in %d s, not %d" % (a[0], b[0], a[1] + b[1], 2 * STEP_SECONDS, 2 * NORMAL_TICKS))
+  lines = []
+  lines.append("// Generated by host/steps.py - don't edit.")
+  lines.append("//")
+  lines.append("// Each step is a tick pattern, a bit a tenth, low bit first. Step 2n and")
+  lines.append("// 2n + 1 are a pair, which run for the same time and keep time between them.")
+  lines.append("")
+  lines.append("#define STEP_SECONDS (%d)" % STEP_SECONDS)
+  lines.append("#define STEP_TENTHS (%d)" % STEP_TENTHS)
+  lines.append("#define STEP_BYTES (%d)" % STEP_BYTES)
+  lines.append("#define SPEED_PAIRS (%d)" % count)
+  lines.append("")
+  lines.append("PROGMEM const unsigned char steps[%d] = {" % (2 * count * STEP_BYTES))
+  for a, b in PAIRS:
+    for name, ticks, first in (a, b):
+      bits = pattern(name, ticks, first)
+      packed = [(bits >> (8 * i)) & 0xff for i in range(STEP_BYTES)]
+      lines.append("  %s // %s, %d ticks" % (" ".join("0x%02x," % x for x in packed), name, ticks))
+  lines.append("};")
+  return "\n".join(lines) + "\n"
+
+def define(text, name):
+  m = re.search(r"#define %s \((\d+)\)" % name, text)
+  if not m: sys.exit("no %s" % name)
+  return int(m.group(1))
+
+def check(path):
+  text = open(path).read()
+  m = re.search(r"\bsteps\[\w*\] = \{(.*?)\};", text, re.S)
+  if not m: sys.exit("no steps[] table")
+  table = [int(x, 0) for x in re.sub(r"//.*", "", m.group(1)).replace(",", " ").split()]
+  tenths = define(text, "STEP_TENTHS")
+  size = define(text, "STEP_BYTES")
+  pairs = define(text, "SPEED_PAIRS")
+  failed = False
+  if size * 8 < tenths or len(table) != 2 * pairs * size:
+    print("FAIL: the table is the wrong size")
+    return 1
+  ticks = []
+  for n in range(2 * pairs):
+    bits = sum(b << (8 * i) for i, b in enumerate(table[n * size:(n + 1) * size]))
+    if bits >> tenths:
+      print("FAIL: step %d ticks past the end of its %d tenths" % (n, tenths))
+      failed = True
+    ticks.append(bin(bits).count("1"))
+  for n in range(pairs):
+    a, b = ticks[2 * n], ticks[2 * n + 1]
+    normal = tenths // IRQS_PER_SECOND
+    print("pair %d: %d and %d ticks in %d s" % (n, a, b, normal))
+    if a + b != 2 * normal:
+      print("FAIL: pair %d doesn't tick once a second between them" % n)
+      failed = True
+  if pairs & (pairs - 1):
+    print("FAIL: picking one of %d pairs takes a division" % pairs)
+    failed = True
+  if text != generate():
+    print("FAIL: %s isn't what steps.py compiles to" % path)
+    failed = True
+  return 1 if failed else 0
+
+def main():
+  parser = argparse.ArgumentParser(description="Compile crazy.c's step patterns")
+  parser.add_argument("--check", metavar="STEPS_H", help="check a table instead of writing one")
+  args = parser.parse_args()
+  if args.check:
+    return check(args.check)
+  sys.stdout.write(generate())
+  return 0
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,95 @@
+/*
+
+ Crazy Clock sweep drive check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and normal.c, built for a sweep movement, in the host
+ * simulator. The step pulses are started and stopped by the timer ISRs, so
+ * the pins are watched after every interrupt. Every step must be the same
+ * short width, the polarity must alternate, and the steps must be evenly
+ * spaced - SWEEP_STEPS of them for every second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hostsim.h"
+
+#define DAYS (1)
+#define CRYSTAL (32768)
+#define PINS (0x03) // PB0 and PB1
+#define SPACING (CRYSTAL / SWEEP_STEPS)
+#ifndef SWEEP_PULSE
+#define SWEEP_PULSE (24) // as in base.c
+#endif
+// The pulse ends at the compare B match after the count resets.
+#define WIDTH ((SWEEP_PULSE + 1) * 8)
+
+extern volatile uint8_t PORTB;
+
+static uint8_t last_pins;
+static uint64_t rise, last_rise;
+static int last_pin = -1;
+static unsigned long steps, uneven;
+static int failed;
+
+static void watch() {
+  uint8_t pins = PORTB & PINS;
+  if (pins == last_pins) return;
+  if (pins == (PINS)) {
+    printf("FAIL: both coil pins high at cycle %llu\n", (unsigned long long)host_cycles);
+    failed = 1;
+  } else if (pins) {
+    int pin = pins == 1 ? 0 : 1;
+    if (pin == last_pin) {
+      printf("FAIL: same polarity twice at cycle %llu\n", (unsigned long long)host_cycles);
+      failed = 1;
+    }
+    last_pin = pin;
+    // The trim nudges a sub-tick by a count now and then.
+    if (steps && llabs((long long)(host_cycles - last_rise) - SPACING) > 8) uneven++;
+    last_rise = rise = host_cycles;
+    steps++;
+  } else if (host_cycles - rise != WIDTH) {
+    printf("FAIL: step at cycle %llu was %llu cycles long\n", (unsigned long long)rise,
+      (unsigned long long)(host_cycles - rise));
+    failed = 1;
+  }
+  last_pins = pins;
+}
+
+int main() {
+  host_isr_hook = watch;
+  host_stop = DAYS * 86400ULL * CRYSTAL;
+  host_run();
+
+  unsigned long want = DAYS * 86400UL * SWEEP_STEPS;
+  printf("%d steps a second: %lu interrupts, %lu steps, %lu unevenly spaced\n",
+    SWEEP_STEPS, host_isr_count, steps, uneven);
+  // The first and last seconds may be cut short.
+  if (steps + SWEEP_STEPS < want || steps > want + SWEEP_STEPS) {
+    printf("FAIL: there should have been %lu steps\n", want);
+    failed = 1;
+  }
+  if (uneven) {
+    printf("FAIL: the steps weren't evenly spaced\n");
+    failed = 1;
+  }
+  return failed;
+}
@@ -0,0 +1,97 @@
+/*
+
+ Crazy Clock background task check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and normal.c in the host simulator with a few extra
+ * background tasks, each of which really does take nearly as long as it
+ * claims. None of them may ever make the clock work through an interrupt,
+ * even though a tick pulse eats 15 of the 51 timer counts in a tenth. The
+ * ones that fit should run on schedule, in order of priority, and the one
+ * that never fits must never run.
+ */
+
+#include <stdio.h>
+
+#include "hostsim.h"
+
+#define DAYS (1)
+#define TENTHS (DAYS * 864000L)
+#define COUNT (64) // CPU cycles per timer count
+
+extern void addTask(void (*task)(), unsigned long period, unsigned char cost);
+
+struct job {
+  unsigned char cost;
+  unsigned long period;
+  unsigned long runs;
+};
+
+static struct job jobs[] = {
+  { 40, 50, 0 }, // only ever fits in a tenth without a tick
+  { 30, 0, 0 }, // every tenth it can, even after a tick
+  { 50, 10, 0 }, // never fits
+};
+
+static void work(struct job *j) {
+  j->runs++;
+  host_advance(host_cycles + (j->cost - 1) * COUNT);
+}
+
+static void job0() { work(&jobs[0]); }
+static void job1() { work(&jobs[1]); }
+static void job2() { work(&jobs[2]); }
+
+int main() {
+  int failed = 0;
+  addTask(job0, jobs[0].period, jobs[0].cost);
+  addTask(job1, jobs[1].period, jobs[1].cost);
+  addTask(job2, jobs[2].period, jobs[2].cost);
+  host_stop = DAYS * 86400ULL * 32768;
+  host_run();
+
+  printf("%lu interrupts, %lu while awake\n", host_isr_count, host_isr_awake);
+  for(int i = 0; i < 3; i++)
+    printf("cost %d every %lu: ran %lu times\n", jobs[i].cost, jobs[i].period, jobs[i].runs);
+  if (host_isr_awake) {
+    printf("FAIL: the tasks made the clock work through interrupts\n");
+    failed = 1;
+  }
+  // The first one waits past any tenth with a tick in it, so its period
+  // stretches a little.
+  if (jobs[0].runs < TENTHS / 52 || jobs[0].runs > TENTHS / 50) {
+    printf("FAIL: the 5 second task didn't keep to its period\n");
+    failed = 1;
+  }
+  // The second gets the tenths that the first doesn't. Right after the
+  // interrupt, before the counter resets, haveTime() can't always tell how
+  // much is left and has to say no. Time doesn't pass in the simulated ISR,
+  // so that happens here far more than it would for real, but it still has
+  // to get most of them.
+  unsigned long spare = TENTHS - jobs[0].runs;
+  if (jobs[1].runs < spare * 85 / 100 || jobs[1].runs > spare) {
+    printf("FAIL: the every-tenth task should have run nearly %lu times\n", spare);
+    failed = 1;
+  }
+  if (jobs[2].runs) {
+    printf("FAIL: a task ran without enough time for it\n");
+    failed = 1;
+  }
+  return failed;
+}
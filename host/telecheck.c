@@ -0,0 +1,150 @@
+/*
+
+ Crazy Clock telemetry check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs base.c and crazy.c, built with TELEMETRY, in the host simulator
+ * for a few hours, and decodes the serial line the way a UART would: from
+ * the falling edge of each start bit, sampling the middle of every bit. Every
+ * frame must arrive whole, with the right checksum, once a minute, and the
+ * counters must make sense. Sending it must never make the clock work
+ * through an interrupt or overrun a tenth. (Starting up does both once, with
+ * or without TELEMETRY, so that's counted from the first bit sent.)
+ *
+ * Code takes no time in the simulator, so a bit here is only the delay part
+ * of base.c's bit time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hostsim.h"
+#include "../telemetry.h"
+
+#define HOURS (4)
+#define BIT (32768 / TELEMETRY_BAUD) // on the host, the bit loop is all delay
+#define TRIM (123)
+#define MAX_LOWS (HOURS * 60 * sizeof(struct telemetry_frame) * 10)
+
+extern volatile uint8_t PORTB;
+
+// When the line was low. It's high the rest of the time.
+static struct { uint64_t start, end; } lows[MAX_LOWS];
+static unsigned long low_count;
+static unsigned long awake_before_sending;
+
+static void delayed(uint64_t start, uint64_t length) {
+  if (PORTB & (1 << 2)) return; // PB2
+  if (!low_count) awake_before_sending = host_isr_awake;
+  if (low_count && lows[low_count - 1].end == start) {
+    lows[low_count - 1].end = start + length;
+    return;
+  }
+  if (low_count >= MAX_LOWS) {
+    printf("FAIL: the line was low too often\n");
+    exit(1);
+  }
+  lows[low_count].start = start;
+  lows[low_count].end = start + length;
+  low_count++;
+}
+
+// The line level at the given cycle, given the low stretch at or after it.
+static int level(uint64_t when, unsigned long *next) {
+  while(*next < low_count && lows[*next].end <= when) (*next)++;
+  return !(*next < low_count && lows[*next].start <= when);
+}
+
+int main() {
+  int failed = 0;
+  host_eeprom[4] = TRIM & 0xff;
+  host_eeprom[5] = TRIM >> 8;
+  host_delay_hook = delayed;
+  host_stop = HOURS * 3600ULL * 32768;
+  host_run();
+
+  unsigned char bytes[MAX_LOWS];
+  unsigned long byte_count = 0, framing = 0;
+  unsigned long next = 0;
+  while(next < low_count) {
+    uint64_t start = lows[next].start;
+    unsigned char b = 0;
+    for(int i = 0; i < 8; i++)
+      if (level(start + BIT * (i + 1) + BIT / 2, &next)) b |= 1 << i;
+    if (!level(start + BIT * 9 + BIT / 2, &next)) framing++;
+    bytes[byte_count++] = b;
+    // Look for the next start bit after this stop bit.
+    uint64_t done = start + BIT * 10;
+    while(next < low_count && lows[next].start < done) {
+      if (lows[next].end > done) {
+        lows[next].start = done;
+        break;
+      }
+      next++;
+    }
+  }
+
+  struct telemetry_frame f, first, last;
+  unsigned long frames = 0, bad = 0;
+  for(unsigned long i = 0; i + sizeof(f) <= byte_count; ) {
+    if (bytes[i] != TELEMETRY_SYNC || telemetrySum(bytes + i) != 0) {
+      bad++;
+      i++;
+      continue;
+    }
+    memcpy(&f, bytes + i, sizeof(f));
+    i += sizeof(f);
+    if (frames) {
+      if (f.sequence != (uint8_t)(last.sequence + 1)) {
+        printf("FAIL: frame %u came after %u\n", f.sequence, last.sequence);
+        failed = 1;
+      }
+      // The frame is taken the first tenth there's time after each minute.
+      if (f.wakes - last.wakes < TELEMETRY_INTERVAL || f.wakes - last.wakes > TELEMETRY_INTERVAL + 5) {
+        printf("FAIL: frame %u came %lu tenths after the last\n", f.sequence, (unsigned long)(f.wakes - last.wakes));
+        failed = 1;
+      }
+    }
+    if (!frames) first = f;
+    if (f.trim != TRIM || f.overrun_total != first.overrun_total || f.battery != 0) {
+      printf("FAIL: frame %u says trim %d, %lu overruns, battery %d\n", f.sequence, f.trim,
+        (unsigned long)f.overrun_total, f.battery);
+      failed = 1;
+    }
+    last = f;
+    frames++;
+  }
+
+  printf("%lu bytes, %lu framing errors, %lu frames, %lu bytes out of frame, %lu interrupts while awake\n",
+    byte_count, framing, frames, bad, host_isr_awake - awake_before_sending);
+  if (frames < HOURS * 60 - 1) {
+    printf("FAIL: there should have been a frame a minute\n");
+    failed = 1;
+  }
+  if (framing || bad) {
+    printf("FAIL: the serial line was garbled\n");
+    failed = 1;
+  }
+  if (host_isr_awake != awake_before_sending) {
+    printf("FAIL: sending made the clock work through interrupts\n");
+    failed = 1;
+  }
+  return failed;
+}
@@ -0,0 +1,75 @@
+/*
+
+ Crazy Clock telemetry decoder
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This reads the raw bytes from a clock built with TELEMETRY - from a serial
+ * adapter on PB2 at 300 baud, 8N1, or from 'avrsim -u' - and prints each
+ * frame. Anything that isn't part of a good frame is skipped, so it's fine
+ * to start listening partway through one.
+ *
+ * usage: teledecode [file]
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../telemetry.h"
+
+static const char *battery(uint8_t level) {
+  switch(level) {
+    case 0: return "ok";
+    case 1: return "low";
+    case 2: return "critical";
+    case 3: return "fallback";
+    case TELEMETRY_NO_BATTERY: return "not monitored";
+    default: return "?";
+  }
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if (argc > 1 && !(in = fopen(argv[1], "rb"))) {
+    perror(argv[1]);
+    return 2;
+  }
+  // A window one frame long, sliding along one byte at a time until it
+  // holds a good frame.
+  unsigned char window[sizeof(struct telemetry_frame)];
+  size_t have = 0;
+  unsigned long skipped = 0;
+  int c;
+  while((c = getc(in)) != EOF) {
+    window[have++] = c;
+    if (have < sizeof(window)) continue;
+    if (window[0] != TELEMETRY_SYNC || telemetrySum(window) != 0) {
+      memmove(window, window + 1, --have);
+      skipped++;
+      continue;
+    }
+    struct telemetry_frame f;
+    memcpy(&f, window, sizeof(f));
+    have = 0;
+    printf("frame %u: %lu wakes (%.1f hours), overruns %lu (max %u), %u seed saves, trim %d, battery %s\n",
+      f.sequence, (unsigned long)f.wakes, f.wakes / 36000.0, (unsigned long)f.overrun_total,
+      f.overrun_max, f.saves, f.trim, battery(f.battery));
+  }
+  if (skipped) fprintf(stderr, "%lu bytes skipped\n", skipped);
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+
+ Crazy Clock temperature compensation model
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs the tempcomp.h math against a year of synthetic temperature
+ * for a handful of different environments. The crystal follows the
+ * textbook parabola, the sensor is quantized to whole degrees, and the
+ * correction goes through the same integer trim path that the ISR uses.
+ * It prints the average daily error with and without compensation, and
+ * fails if compensation doesn't help enough.
+ *
+ * It also prints what the sampling costs, using datasheet numbers.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tempcomp.h"
+
+#define TURNOVER (25.0)
+#define COEFF (-0.034) // ppm per degree squared
+#define STEP (10) // seconds per integration step
+#define DAYS (365)
+
+// The ADC readings in tempcomp.h are at the 10 Hz rate.
+#define SAMPLE_SECONDS (TEMP_SAMPLE_INTERVAL / 10)
+
+// The temperature profiles. t is in seconds from midnight, January 1.
+static double heated(double t) {
+  return 21.0 + sin(2 * M_PI * t / 86400.0);
+}
+
+static double unheated(double t) {
+  return 10.0 - 4.0 * cos(2 * M_PI * t / 86400.0) - 6.0 * cos(2 * M_PI * t / (86400.0 * 365));
+}
+
+static double garage(double t) {
+  return 15.0 - 5.0 * cos(2 * M_PI * t / 86400.0) - 20.0 * cos(2 * M_PI * t / (86400.0 * 365));
+}
+
+static double window(double t) {
+  double tod = fmod(t, 86400.0);
+  return (tod > 12 * 3600 && tod < 15 * 3600) ? 40.0 : 20.0;
+}
+
+struct profile {
+  const char *name;
+  double (*temp)(double);
+};
+
+static const struct profile profiles[] = {
+  { "heated room", heated },
+  { "unheated room", unheated },
+  { "garage", garage },
+  { "sunny window", window },
+};
+
+// This mirrors setTrim() and the ISR: one count is nudged every
+// 10000000 / |trim| counts, so the effective trim is slightly larger
+// than asked for.
+static double effectiveTrim(int trim) {
+  if (trim == 0) return 0;
+  unsigned long cycles = 10000000 / abs(trim);
+  return (trim < 0 ? -1.0 : 1.0) * 10000000.0 / cycles;
+}
+
+int main() {
+  int failed = 0;
+  printf("%-16s %12s %12s\n", "profile", "raw s/day", "comp s/day");
+  for(unsigned int p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+    double raw = 0, comp = 0;
+    double trim = 0; // tenths-of-a-ppm, positive slows the clock.
+    for(long t = 0; t < DAYS * 86400L; t += STEP) {
+      double temp = profiles[p].temp(t);
+      if (t % SAMPLE_SECONDS == 0) {
+        // The sensor is 1 LSB per degree. The calibration value is the
+        // reading at the turnover point, so the offset cancels out.
+        int reading = (int)lround(temp) + TEMP_DEFAULT_CAL - (int)TURNOVER;
+        trim = effectiveTrim(tempCorrection(reading, TEMP_DEFAULT_CAL));
+      }
+      double crystal = COEFF * (temp - TURNOVER) * (temp - TURNOVER); // ppm, negative is slow
+      raw += crystal * 1e-6 * STEP;
+      comp += (crystal - trim / 10.0) * 1e-6 * STEP;
+    }
+    raw /= DAYS;
+    comp /= DAYS;
+    printf("%-16s %12.3f %12.3f\n", profiles[p].name, raw, comp);
+    // Whole-degree quantization leaves a little behind, but it must be a lot
+    // better than doing nothing.
+    if (fabs(comp) > 0.05 && fabs(comp) > fabs(raw) / 10) {
+      printf("FAIL: %s is not compensated well enough\n", profiles[p].name);
+      failed = 1;
+    }
+  }
+
+  // What does it cost? From the datasheet: the ADC draws about 300 uA while
+  // enabled, and the CPU about 10 uA more running than idle at 32 kHz.
+  // readADC() takes about 80 cycles of conversion plus 30 of overhead, and
+  // setTrim()'s long division is about 700 cycles.
+  double adc_seconds = 110.0 / 32768;
+  double cpu_seconds = 810.0 / 32768;
+  double charge = adc_seconds * 300e-6 + cpu_seconds * 10e-6;
+  printf("sample cost: %.1f ms, %.2f uC every %d seconds = %.1f nA average\n",
+    cpu_seconds * 1000, charge * 1e6, SAMPLE_SECONDS, charge / SAMPLE_SECONDS * 1e9);
+
+  return failed;
+}
@@ -0,0 +1,189 @@
+/*
+
+ Crazy Clock tick trace compare
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This compares two tick traces and says where they first part ways. A
+ * trace is either what hosttrace and avrsim write - a line per tick with its
+ * tenth and coil pin - or the run-length form the golden traces are kept in.
+ * The run-length form is:
+ *
+ *   rle 1
+ *   COUNT GAP       COUNT ticks, each GAP tenths after the one before
+ *   COUNT GAP same  the same, but on the same pin as the one before
+ *   ...
+ *
+ * The first tick's gap is from tenth 0, and it's on pin 0 unless its run
+ * says 'same' - then it's on pin 1. Otherwise the pins alternate.
+ *
+ * Either one may be gzipped. Both traces are turned into runs, and runs that
+ * match are skipped whole, so comparing a week of ticks takes next to no time.
+ *
+ * usage: tracediff A B     ('-' is stdin) exits 1 if they differ
+ *        tracediff -r [A]  writes A in run-length form
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define RLE_HEADER "rle 1"
+#define TENTHS_PER_DAY (864000UL)
+
+struct run {
+  unsigned long count, gap;
+  int same; // the pin didn't change
+};
+
+struct trace {
+  const char *name;
+  struct run *runs;
+  size_t count, size;
+};
+
+static void add(struct trace *t, unsigned long count, unsigned long gap, int same) {
+  struct run *last = t->count ? t->runs + t->count - 1 : NULL;
+  if (last && last->gap == gap && last->same == same) {
+    last->count += count;
+    return;
+  }
+  if (t->count == t->size) {
+    t->size = t->size ? t->size * 2 : 1024;
+    if (!(t->runs = realloc(t->runs, t->size * sizeof(*t->runs)))) {
+      perror(t->name);
+      exit(2);
+    }
+  }
+  t->runs[t->count].count = count;
+  t->runs[t->count].gap = gap;
+  t->runs[t->count].same = same;
+  t->count++;
+}
+
+static void load(struct trace *t, const char *name) {
+  gzFile in = strcmp(name, "-") ? gzopen(name, "r") : gzdopen(0, "r");
+  if (!in) {
+    perror(name);
+    exit(2);
+  }
+  t->name = name;
+  char line[64];
+  if (!gzgets(in, line, sizeof(line))) {
+    gzclose(in);
+    return;
+  }
+  if (strncmp(line, RLE_HEADER, strlen(RLE_HEADER)) == 0) {
+    while(gzgets(in, line, sizeof(line))) {
+      char *p;
+      unsigned long count = strtoul(line, &p, 10);
+      unsigned long gap = strtoul(p, &p, 10);
+      while(*p == ' ') p++;
+      add(t, count, gap, strncmp(p, "same", 4) == 0);
+    }
+  } else {
+    unsigned long last_tenth = 0;
+    int last_pin = 0;
+    do {
+      char *p;
+      unsigned long tenth = strtoul(line, &p, 10);
+      int pin = strtoul(p, NULL, 10);
+      if (tenth < last_tenth) {
+        fprintf(stderr, "%s: tenth %lu comes after %lu\n", name, tenth, last_tenth);
+        exit(2);
+      }
+      add(t, 1, tenth - last_tenth, t->count ? pin == last_pin : pin == 1);
+      last_tenth = tenth;
+      last_pin = pin;
+    } while(gzgets(in, line, sizeof(line)));
+  }
+  gzclose(in);
+}
+
+static void when(unsigned long tenth) {
+  unsigned long day = tenth / TENTHS_PER_DAY;
+  tenth %= TENTHS_PER_DAY;
+  printf("tenth %lu (day %lu, %02lu:%02lu:%02lu.%lu)", day * TENTHS_PER_DAY + tenth, day,
+    tenth / 36000, tenth / 600 % 60, tenth / 10 % 60, tenth % 10);
+}
+
+static void describe(const struct trace *t, size_t run, unsigned long tenth) {
+  printf("  %s: ", t->name);
+  if (run >= t->count) {
+    printf("no more ticks\n");
+    return;
+  }
+  when(tenth + t->runs[run].gap);
+  printf(", %s pin\n", t->runs[run].same ? "same" : "other");
+}
+
+static int compare(struct trace *a, struct trace *b) {
+  size_t i = 0, j = 0;
+  // How many of the current run in each are already used up.
+  unsigned long used_a = 0, used_b = 0;
+  unsigned long tenth = 0, ticks = 0;
+  while(i < a->count && j < b->count) {
+    struct run *ra = a->runs + i, *rb = b->runs + j;
+    if (ra->gap != rb->gap || ra->same != rb->same) break;
+    unsigned long left_a = ra->count - used_a, left_b = rb->count - used_b;
+    unsigned long n = left_a < left_b ? left_a : left_b;
+    tenth += n * ra->gap;
+    ticks += n;
+    if ((used_a += n) == ra->count) {
+      i++;
+      used_a = 0;
+    }
+    if ((used_b += n) == rb->count) {
+      j++;
+      used_b = 0;
+    }
+  }
+  if (i >= a->count && j >= b->count) {
+    printf("%lu ticks, the same\n", ticks);
+    return 0;
+  }
+  printf("the same for %lu ticks, up to ", ticks);
+  when(tenth);
+  printf(". The next tick:\n");
+  describe(a, i, tenth);
+  describe(b, j, tenth);
+  return 1;
+}
+
+static void writeRle(const struct trace *t) {
+  printf(RLE_HEADER "\n");
+  for(size_t i = 0; i < t->count; i++)
+    printf("%lu %lu%s\n", t->runs[i].count, t->runs[i].gap, t->runs[i].same ? " same" : "");
+}
+
+int main(int argc, char **argv) {
+  struct trace a = { 0 }, b = { 0 };
+  if (argc >= 2 && argc <= 3 && strcmp(argv[1], "-r") == 0) {
+    load(&a, argc > 2 ? argv[2] : "-");
+    writeRle(&a);
+    return 0;
+  }
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s A B\n       %s -r [A]\n", argv[0], argv[0]);
+    return 2;
+  }
+  load(&a, argv[1]);
+  load(&b, argv[2]);
+  return compare(&a, &b);
+}
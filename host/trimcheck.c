@@ -0,0 +1,106 @@
+/*
+
+ Crazy Clock trim check
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This runs the real base.c and normal.c in the host simulator against a
+ * crystal with a known frequency error, with and without the matching trim
+ * value in EEPROM. It times the ticks against real time, and checks that the
+ * rate error comes out the way it should. It also checks that the tick
+ * polarity alternates.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "hostsim.h"
+
+#define DAYS (2)
+// The coil pins: PB0 and PB1, or PA2 and PA3 on the 1-series (see hal_rtc.h).
+#ifndef COIL_PINS
+#define COIL_PINS 0x01, 0x02
+#endif
+
+struct scenario {
+  double ppm; // of the crystal
+  int16_t trim; // in EEPROM, tenths of a ppm
+};
+
+static const struct scenario scenarios[] = {
+  { 0, 0 },
+  { 25.3, 0 },
+  { 25.3, 253 },
+  { -17.8, -178 },
+  { 150, 1500 },
+  { -150, -1000 },
+};
+
+static const uint8_t coil_pins[] = { COIL_PINS };
+static unsigned long ticks;
+static uint64_t first, last;
+static uint8_t last_pins;
+static int polarity_errors;
+
+static void pulse(uint8_t pins, uint64_t start, uint64_t length) {
+  if (ticks++ == 0) first = start;
+  last = start;
+  if (pins == last_pins || (pins != coil_pins[0] && pins != coil_pins[1])) polarity_errors++;
+  last_pins = pins;
+}
+
+static double expected;
+
+static int check(void) {
+  double elapsed = host_seconds(last - first);
+  double error = (elapsed - (ticks - 1)) / (ticks - 1) * 1e6; // ppm, positive is slow
+  printf("%8.1f ppm crystal, %6d trim: %8.3f ppm fast, expected %8.3f\n",
+    host_ppm, (int)(*(int16_t*)(host_eeprom + 4)), -error, expected);
+  if (polarity_errors) {
+    printf("FAIL: %d ticks had the wrong polarity\n", polarity_errors);
+    return 1;
+  }
+  // The interrupt pattern and trim nudges jitter the ticks by a few ms.
+  if (fabs(-error - expected) > 0.1) {
+    printf("FAIL: rate is off\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  int failed = 0;
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  host_pulse = pulse;
+  for(unsigned int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    memset(host_eeprom, 0xff, HOST_EEPROM_SIZE);
+    memcpy(host_eeprom + 4, &scenarios[i].trim, sizeof(scenarios[i].trim));
+    host_ppm = scenarios[i].ppm;
+    host_stop = host_crystal(DAYS * 86400.0);
+    // Positive trim slows the clock down.
+    expected = host_ppm - scenarios[i].trim / 10.0;
+    if (host_boot(check) != 0) failed = 1;
+  }
+  gettimeofday(&end, NULL);
+  double wall = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("%.1f million interrupts per second\n", sizeof(scenarios) / sizeof(scenarios[0]) * DAYS * 864000 / wall / 1e6);
+  return failed;
+}
@@ -0,0 +1,14 @@
+// Host shim for <util/atomic.h>. See hostsim.h.
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <stdint.h>
+
+void host_atomic_enter(void);
+uint8_t host_atomic_exit(void);
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for(uint8_t __todo = (host_atomic_enter(), 1); __todo; __todo = host_atomic_exit())
+
+#endif
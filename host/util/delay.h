@@ -0,0 +1,13 @@
+// Host shim for <util/delay.h>. See hostsim.h.
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#include <stdint.h>
+
+void host_delay(uint64_t cycles);
+
+#define _delay_ms(ms) host_delay((uint64_t)((ms) * (F_CPU / 1000.0)))
+#define _delay_us(us) host_delay((uint64_t)((us) * (F_CPU / 1000000.0)))
+#define __builtin_avr_delay_cycles(cycles) host_delay(cycles)
+
+#endif
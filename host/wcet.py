@@ -0,0 +1,550 @@
+#!/usr/bin/env python3
+#
+# Crazy Clock static worst-case execution time report
+# Copyright 2014 Nicholas W. Sayer
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+# This disassembles a clock image and works out an upper bound on the CPU
+# cycles between waking up and going back to sleep, over every path through
+# the code - not just the ones a simulation happens to take. Clock code must
+# never work through an interrupt, and the shortest interval between them is
+# 51 timer counts of 64 cycles, so anything over 3264 cycles is flagged.
+#
+# A region starts when doSleep() returns after waking and ends at the next
+# call to doSleep() (or a sleep instruction). The catch-up path, where
+# doSleep() returns without sleeping, isn't counted - it's only taken when
+# the clock is already behind. The timer ISR is added once to every region.
+#
+# Loops that don't contain a region boundary need a bound. Simple counted
+# loops (ldi, then dec or sbiw down to zero) are bounded automatically. The
+# rest come from the bounds file, as lines of
+#
+#   loop TYPE FUNCTION ITERATIONS
+#   icall TYPE FUNCTION TARGET...
+#
+# where TYPE is the clock type or *. A loop bound is the most times any loop
+# in that function can go around in total. The icall lines list the functions
+# an indirect call can reach. Anything unbounded is reported as such.
+#
+# The only function pointers the clocks call through are the background
+# tasks, so every icall line has to list every function the image hands to
+# addTask(). Those are read out of the calls to it, and a task missing from a
+# list is a failure, as is a call to addTask() whose task can't be worked out.
+#
+# usage: wcet.py [-b bounds] [-d disassembly] [--objdump avr-objdump] file.elf...
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+INTERVAL = 51 * 64
+# Every ISR costs this on top of its body. A multi-cycle instruction like ret
+# holds the interrupt off until it finishes, and then the response pushes the
+# PC and jumps to the vector.
+ISR_OVERHEAD = (3 # the rest of the longest instruction (ret is 4)
+  + 4 # the interrupt response
+  + 2) # the rjmp in the vector table
+BOUNDARY = ('doSleep',)
+
+NEG = float('-inf')
+INF = float('inf')
+
+# Cycle counts for the AVRe core in the ATtiny parts. Branches and skips are
+# counted as taken.
+CYCLES = {
+    'adiw': 2, 'sbiw': 2, 'ld': 2, 'ldd': 2, 'st': 2, 'std': 2, 'lds': 2, 'sts': 2,
+    'push': 2, 'pop': 2, 'cbi': 2, 'sbi': 2, 'rjmp': 2, 'ijmp': 2, 'lpm': 3, 'elpm': 3,
+    'jmp': 3, 'rcall': 3, 'icall': 3, 'call': 4, 'ret': 4, 'reti': 4,
+    'cpse': 3, 'sbrc': 3, 'sbrs': 3, 'sbic': 3, 'sbis': 3,
+}
+BRANCHES = ('breq', 'brne', 'brcs', 'brcc', 'brsh', 'brlo', 'brmi', 'brpl', 'brge', 'brlt',
+            'brhs', 'brhc', 'brts', 'brtc', 'brvs', 'brvc', 'brie', 'brid', 'brbs', 'brbc')
+SKIPS = ('cpse', 'sbrc', 'sbrs', 'sbic', 'sbis')
+# Instructions that don't write their first operand.
+NO_WRITE = ('st', 'std', 'sts', 'out', 'cp', 'cpc', 'cpi', 'cpse', 'sbrc', 'sbrs', 'push', 'tst',
+            'sbic', 'sbis', 'cbi', 'sbi', 'bst')
+
+SYMBOL = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
+INSN = re.compile(r'^\s*([0-9a-f]+):\s+((?:[0-9a-f]{2} )+)\s*(\S+)\s*([^;]*?)\s*(?:;\s*(?:0x([0-9a-f]+))?.*)?$')
+
+
+class Insn:
+    def __init__(self, addr, size, op, args, target):
+        self.addr = addr
+        self.size = size
+        self.op = op
+        self.args = [a.strip() for a in args.split(',')] if args else []
+        self.target = target
+
+    def cost(self):
+        if self.op in BRANCHES:
+            return 2
+        return CYCLES.get(self.op, 1)
+
+
+class Image:
+    def __init__(self, text, clock, bounds):
+        self.insns = {}
+        self.symbols = {}
+        self.clock = clock
+        self.loop_bounds = {}
+        self.icalls = {}
+        for kind, who, func, rest in bounds:
+            if who not in ('*', clock):
+                continue
+            if kind == 'loop':
+                self.loop_bounds[func] = int(rest[0])
+            else:
+                self.icalls.setdefault(func, []).extend(rest)
+        for line in text.splitlines():
+            m = SYMBOL.match(line)
+            if m:
+                self.symbols[int(m.group(1), 16)] = m.group(2)
+                continue
+            m = INSN.match(line)
+            if not m or m.group(3).startswith('.'):
+                continue
+            addr = int(m.group(1), 16)
+            target = int(m.group(5), 16) if m.group(5) else None
+            args = m.group(4)
+            if target is None and args.startswith('.'):
+                target = addr + 2 + int(args[1:], 0)
+            self.insns[addr] = Insn(addr, len(m.group(2).split()), m.group(3), args, target)
+        self.by_name = dict((n, a) for a, n in self.symbols.items())
+        self.summaries = {}
+        self.active = set()
+        self.notes = []
+        self.regions = []
+        # Anything that's called is a function. Everything else is reached
+        # by jumps from inside one.
+        self.entries = set(i.target for i in self.insns.values() if i.op in ('rcall', 'call'))
+        for targets in self.icalls.values():
+            self.entries.update(self.by_name[t] for t in targets if t in self.by_name)
+
+    def name(self, addr):
+        best = None
+        for a in self.symbols:
+            if a <= addr and (best is None or a > best):
+                best = a
+        if best is None:
+            return '0x%x' % addr
+        if best == addr:
+            return self.symbols[best]
+        return '%s+0x%x' % (self.symbols[best], addr - best)
+
+    # The functions handed to addTask(). avr-gcc loads the first argument's
+    # word address into r24 and r25 just before the call.
+    def tasks(self):
+        found, unknown = set(), []
+        add = self.by_name.get('addTask')
+        if add is None:
+            return found, unknown
+        addrs = sorted(self.insns)
+        for n, a in enumerate(addrs):
+            i = self.insns[a]
+            if i.op not in ('rcall', 'call', 'rjmp', 'jmp') or i.target != add:
+                continue
+            regs = {}
+            for b in reversed(addrs[max(0, n - 12):n]):
+                j = self.insns[b]
+                if j.op in ('rcall', 'call', 'icall', 'ret') or j.op in BRANCHES:
+                    break
+                if j.op == 'ldi' and j.args[0] in ('r24', 'r25') and j.args[0] not in regs:
+                    regs[j.args[0]] = int(j.args[1], 0)
+            task = None
+            if len(regs) == 2:
+                task = self.symbols.get(2 * (regs['r25'] * 256 + regs['r24']))
+            if task is None:
+                unknown.append(a)
+            else:
+                found.add(task)
+        return found, unknown
+
+    def note(self, what):
+        if what not in self.notes:
+            self.notes.append(what)
+
+    def summary(self, entry):
+        if entry in self.summaries:
+            return self.summaries[entry]
+        if entry in self.active:
+            self.note('recursion through %s' % self.name(entry))
+            return Summary(INF, NEG, NEG, NEG)
+        self.active.add(entry)
+        s = Function(self, entry).analyze()
+        self.active.discard(entry)
+        self.summaries[entry] = s
+        return s
+
+
+class Summary:
+    # through: entry to return without sleeping. enter: entry to the first
+    # sleep. leave: waking to return. All NEG if there's no such path.
+    def __init__(self, through, enter, leave, sleeps):
+        self.through = through
+        self.enter = enter
+        self.leave = leave
+        self.sleeps = sleeps
+
+
+class Node:
+    def __init__(self, insn):
+        self.insn = insn
+        self.through = None  # cycles to pass through without sleeping
+        self.pre = None  # cycles from here to going to sleep
+        self.post = None  # cycles from waking up to leaving here
+        self.label = None
+        self.succ = []  # successor addresses, or None for a return
+
+
+def safe_add(a, b):
+    if a == NEG or b == NEG:
+        return NEG
+    return a + b
+
+
+class Function:
+    def __init__(self, image, entry):
+        self.image = image
+        self.entry = entry
+        self.name = image.name(entry)
+        self.nodes = {}
+
+    def build(self):
+        image = self.image
+        todo = [self.entry]
+        while todo:
+            addr = todo.pop()
+            if addr in self.nodes:
+                continue
+            insn = image.insns.get(addr)
+            if insn is None:
+                image.note('%s runs off into 0x%x' % (self.name, addr))
+                continue
+            node = Node(insn)
+            self.nodes[addr] = node
+            nxt = addr + insn.size
+            op = insn.op
+            if op == 'sleep':
+                node.pre, node.post, node.label = 1, 0, 'sleep'
+                node.succ = [nxt]
+            elif op in ('ret', 'reti'):
+                node.through = insn.cost()
+                node.succ = [None]
+            elif op in ('rcall', 'call', 'icall'):
+                targets = [insn.target] if op != 'icall' else \
+                    [image.by_name[t] for t in image.icalls.get(self.name, []) if t in image.by_name]
+                if not targets:
+                    image.note('indirect call at %s' % image.name(addr))
+                    node.through = INF
+                else:
+                    self.call(node, targets, insn.cost())
+                node.succ = [nxt]
+                if node.through is None and node.post is None:
+                    node.succ = []  # never comes back
+            elif op in ('rjmp', 'jmp'):
+                if insn.target in image.entries and insn.target != self.entry:
+                    self.call(node, [insn.target], insn.cost())  # a tail call
+                    node.succ = [None]
+                else:
+                    node.through = insn.cost()
+                    node.succ = [insn.target]
+            elif op in ('ijmp', 'eijmp'):
+                image.note('indirect jump at %s' % image.name(addr))
+                node.through = INF
+                node.succ = [None]
+            elif op in BRANCHES:
+                node.through = insn.cost()
+                node.succ = [nxt, insn.target]
+            elif op in SKIPS:
+                node.through = insn.cost()
+                after = image.insns.get(nxt)
+                node.succ = [nxt, nxt + (after.size if after else 2)]
+            else:
+                node.through = insn.cost()
+                node.succ = [nxt]
+            todo.extend(s for s in node.succ if s is not None)
+
+    def call(self, node, targets, cost):
+        image = self.image
+        through = enter = leave = NEG
+        for t in targets:
+            s = image.summary(t)
+            if image.name(t) not in BOUNDARY:
+                through = max(through, s.through)
+            enter = max(enter, s.enter)
+            leave = max(leave, s.leave)
+        if through != NEG:
+            node.through = cost + through
+        if enter != NEG:
+            node.pre = cost + enter
+            node.post = leave if leave != NEG else None
+            node.label = '/'.join(image.name(t) for t in targets)
+
+    # Tarjan's algorithm, over the nodes that can be passed through.
+    def components(self):
+        index, low, stack, on = {}, {}, [], set()
+        self.comp = {}
+        comps = []
+
+        def visit(v):
+            work = [(v, iter(self.edges(v)))]
+            index[v] = low[v] = len(index)
+            stack.append(v)
+            on.add(v)
+            while work:
+                u, it = work[-1]
+                pushed = False
+                for w in it:
+                    if w not in index:
+                        index[w] = low[w] = len(index)
+                        stack.append(w)
+                        on.add(w)
+                        work.append((w, iter(self.edges(w))))
+                        pushed = True
+                        break
+                    if w in on:
+                        low[u] = min(low[u], index[w])
+                if pushed:
+                    continue
+                work.pop()
+                if work:
+                    low[work[-1][0]] = min(low[work[-1][0]], low[u])
+                if low[u] == index[u]:
+                    members = []
+                    while True:
+                        w = stack.pop()
+                        on.discard(w)
+                        members.append(w)
+                        self.comp[w] = len(comps)
+                        if w == u:
+                            break
+                    comps.append(members)
+
+        for v in self.nodes:
+            if self.nodes[v].through is not None and v not in index:
+                visit(v)
+        self.comps = comps
+        self.comp_cost = [self.loop_cost(c) for c in comps]
+
+    def edges(self, v):
+        return [s for s in self.nodes[v].succ if s is not None and s in self.nodes and self.nodes[s].through is not None]
+
+    def loop_cost(self, members):
+        nodes = self.nodes
+        total = sum(nodes[m].through for m in members)
+        if len(members) == 1 and members[0] not in nodes[members[0]].succ:
+            return total
+        bound = self.counted(members)
+        if bound is None:
+            bound = self.image.loop_bounds.get(self.name)
+        if bound is None:
+            self.image.note('unbounded loop at %s' % self.image.name(min(members)))
+            return INF
+        return bound * total
+
+    # A loop with a single back edge, a brne (or brpl) right after counting a
+    # register down, and an ldi of that register just before the loop.
+    def counted(self, members):
+        nodes = self.nodes
+        back = [m for m in members for s in nodes[m].succ if s in members and s is not None and s <= m]
+        if len(back) != 1 or nodes[back[0]].insn.op not in ('brne', 'brpl'):
+            return None
+        insns = self.image.insns
+        before = [a for a in members if a + insns[a].size == back[0]]
+        if not before:
+            return None
+        dec = insns[before[0]]
+        if dec.op == 'dec':
+            regs = [dec.args[0]]
+        elif dec.op == 'sbiw' and int(dec.args[1], 0) == 1:
+            lo = int(dec.args[0][1:])
+            regs = ['r%d' % lo, 'r%d' % (lo + 1)]
+        elif dec.op == 'subi' and int(dec.args[1], 0) == 1:
+            regs = [dec.args[0]]
+        else:
+            return None
+        for m in members:
+            i = insns[m]
+            if m != dec.addr and i.args and i.args[0] in regs and i.op not in NO_WRITE:
+                return None
+        # Look a few instructions back from the top of the loop for the ldi.
+        values = {}
+        addr = min(members)
+        for a in sorted((a for a in insns if a < addr), reverse=True)[:8]:
+            i = insns[a]
+            if i.op == 'ldi' and i.args[0] in regs and i.args[0] not in values:
+                values[i.args[0]] = int(i.args[1], 0)
+        if len(values) != len(regs):
+            return None
+        count = 0
+        for r in reversed(regs):
+            count = count * 256 + values[r]
+        if nodes[back[0]].insn.op == 'brpl':
+            return count + 1 if len(regs) == 1 and count < 128 else None
+        return count or 256 ** len(regs)
+
+    # The longest path from each component to the given sink.
+    def longest(self, sink):
+        memo = {}
+        nodes = self.nodes
+
+        def to(addr):
+            if addr is None:
+                return 0 if sink is None else NEG
+            node = nodes.get(addr)
+            if node is None:
+                return NEG
+            best = NEG
+            if node.pre is not None and addr == sink:
+                best = node.pre
+            if node.through is not None:
+                best = max(best, comp(self.comp[addr]))
+            return best
+
+        def comp(c):
+            if c in memo:
+                return memo[c]
+            memo[c] = NEG  # only reachable through a cycle, which is handled
+            best = NEG
+            for m in self.comps[c]:
+                for s in nodes[m].succ:
+                    if s is not None and s in self.comp and self.comp[s] == c:
+                        continue
+                    best = max(best, to(s))
+            memo[c] = safe_add(self.comp_cost[c], best) if best != NEG else NEG
+            return memo[c]
+
+        return to
+
+    def analyze(self):
+        self.build()
+        self.components()
+        cuts = [a for a, n in self.nodes.items() if n.pre is not None]
+        to_ret = self.longest(None)
+        through = to_ret(self.entry) if self.nodes.get(self.entry) and self.nodes[self.entry].through is not None else NEG
+        enter = leave = NEG
+        image = self.image
+        for w in cuts:
+            to_w = self.longest(w)
+            enter = max(enter, to_w(self.entry))
+            for u in cuts:
+                nu = self.nodes[u]
+                if nu.post is None:
+                    continue
+                cost = max([to_w(s) for s in nu.succ] + [NEG])
+                if cost != NEG:
+                    image.regions.append((nu.post + cost, self.name, u, nu.label, w, self.nodes[w].label))
+        for u in cuts:
+            nu = self.nodes[u]
+            if nu.post is not None:
+                leave = max([leave] + [safe_add(nu.post, to_ret(s)) for s in nu.succ])
+        return Summary(through, enter, leave, bool(cuts))
+
+
+def report(path, text, bounds):
+    clock = os.path.basename(path).rsplit('.', 1)[0]
+    image = Image(text, clock, bounds)
+    if 'main' not in image.by_name:
+        print('%s: no main()' % path)
+        return 1
+    isr = 0
+    for addr, name in sorted(image.symbols.items()):
+        if re.match(r'__vector_\d+$', name) and addr in image.insns:
+            s = image.summary(addr)
+            if s.through != NEG:
+                isr += s.through + ISR_OVERHEAD
+    image.summary(image.by_name['main'])
+    failed = False
+    worst = max(image.regions) if image.regions else None
+    if worst is None:
+        print('%s: no sleep regions found' % path)
+        return 1
+    total = worst[0] + isr
+    print('%s: worst wake %s cycles (%s of %d), including %d for interrupts' % (
+        path, 'unbounded' if total == INF else '%d' % total,
+        'unbounded' if total == INF else '%.0f%%' % (total * 100.0 / INTERVAL), INTERVAL, isr))
+    tasks, unknown = image.tasks()
+    for a in unknown:
+        print('  FAIL: can\'t tell which task addTask() is given at 0x%x' % a)
+        failed = True
+    for a, i in sorted(image.insns.items()):
+        if i.op != 'icall':
+            continue
+        func = image.name(a).split('+')[0]
+        missing = sorted(tasks - set(image.icalls.get(func, [])))
+        if missing:
+            print('  FAIL: the indirect call at %s can reach %s, which isn\'t in its icall list' % (
+                image.name(a), ', '.join(missing)))
+            failed = True
+    seen = set()
+    for cost, func, u, ulabel, w, wlabel in sorted(image.regions, reverse=True):
+        key = (func, u, w)
+        if key in seen:
+            continue
+        seen.add(key)
+        cost += isr
+        if cost <= INTERVAL and len(seen) > 5:
+            break
+        flag = 'OVER ' if cost > INTERVAL else '     '
+        print('  %s%9s  %s: after %s at 0x%x -> %s at 0x%x' % (
+            flag, 'unbounded' if cost == INF else '%d' % cost, func, ulabel, u, wlabel, w))
+        if cost > INTERVAL:
+            failed = True
+    for n in image.notes:
+        print('  note: %s' % n)
+    return 1 if failed else 0
+
+
+def read_bounds(path):
+    bounds = []
+    if not path:
+        return bounds
+    with open(path) as f:
+        for line in f:
+            words = line.split('#', 1)[0].split()
+            if not words:
+                continue
+            if words[0] not in ('loop', 'icall') or len(words) < 4:
+                sys.exit('%s: bad line: %s' % (path, line.strip()))
+            bounds.append((words[0], words[1], words[2], words[3:]))
+    return bounds
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Worst case cycles between sleeps for a clock image.')
+    parser.add_argument('-b', '--bounds', help='loop bounds file')
+    parser.add_argument('-d', '--disassembly', help='use this avr-objdump -d output instead of running it')
+    parser.add_argument('--objdump', default='avr-objdump')
+    parser.add_argument('elf', nargs='+')
+    args = parser.parse_args()
+    bounds = read_bounds(args.bounds)
+    failed = 0
+    for path in args.elf:
+        if args.disassembly:
+            with open(args.disassembly) as f:
+                text = f.read()
+        else:
+            text = subprocess.check_output([args.objdump, '-d', path]).decode()
+        failed |= report(path, text, bounds)
+    return failed
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -29,13 +29,11 @@
 void loop() {
   while(1){
     unsigned char tick_count = (q_random() % 30) + 1; //1-30, inclusive
-    
-    for(unsigned char i = 0; i < tick_count; i++) {
-      doTick();
-      doSleep();
-    }
-      
-    for(unsigned short i = 0; i < tick_count * 8; i++)
+
+    // Ten ticks a second, then rest for the rest of their seconds.
+    unsigned short burst = doTickBurst(tick_count, 100);
+
+    for(unsigned short i = burst; i < tick_count * IRQS_PER_SECOND; i++)
       doSleep();
   }
 }
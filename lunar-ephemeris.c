@@ -0,0 +1,93 @@
+/*
+
+ Lunar (synodic) Clock, from a table of the real new moons
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// This clock does 12 hours worth of ticking from one new moon to the next,
+// like lunar.c. But the real months aren't all 29.53 days - they can be more
+// than 6 hours longer or shorter - so lunar.c wanders away from the moon.
+// This one looks up how long each month really is in newmoon.h (made by
+// host/newmoon.py) and ticks just fast enough to fit that month.
+//
+// The clock starts at the new moon in table entry LUNATION. 'newmoon.py --when'
+// will tell you which that is. Set the hand to 12 at that new moon. Past the
+// end of the table, it carries on with mean months.
+
+#if defined(UNIT_TEST)
+// On *nix, there is no PROGMEM. Just make it go away and turn the
+// pgm_read operations into just pointer derefs.
+#define PROGMEM
+#define pgm_read_byte(x) *(x)
+#else
+#include <avr/pgmspace.h>
+#endif
+
+#include "base.h"
+#include "newmoon.h"
+
+#ifndef LUNATION
+#define LUNATION 0
+#endif
+
+// 12 hours
+#define TICKS_PER_LUNATION (43200U)
+
+#define START_TICKS (30 * 5)
+
+void loop() {
+#ifndef UNIT_TEST
+  // When the battery is installed, do a whole bunch of really fast
+  // ticking as a proof of life.
+  // The burst stops at its last tick; sleep out the rest of the 30 s.
+  for(unsigned int i = doTickBurst(START_TICKS, 200); i < START_TICKS * 2; i++)
+    doSleep();
+#endif
+
+  unsigned int lunation = LUNATION;
+  signed char offset = (signed char)pgm_read_byte(newmoon_offset + lunation);
+  while(1) {
+    signed char next = offset;
+    if (lunation + 1 < NEWMOON_COUNT)
+      next = (signed char)pgm_read_byte(newmoon_offset + lunation + 1);
+
+    // This month is this many tenths long. Spread them over the ticks the
+    // customary way: every tick gets 'whole' tenths, and 'extra' of them
+    // get one more. The division is only once a month.
+    unsigned long length = MEAN_LUNATION + (long)(next - offset) * NEWMOON_UNIT;
+    unsigned int whole = length / TICKS_PER_LUNATION;
+    unsigned int extra = length % TICKS_PER_LUNATION;
+
+    unsigned int fractional_position = 0;
+    for(unsigned int tick = 0; tick < TICKS_PER_LUNATION; tick++) {
+      unsigned int tenths = whole;
+      // This is fractional_position += extra, without overflowing 16 bits.
+      if (fractional_position >= TICKS_PER_LUNATION - extra) {
+        fractional_position -= TICKS_PER_LUNATION - extra;
+        tenths++;
+      } else {
+        fractional_position += extra;
+      }
+      doTick();
+      for(unsigned int i = 1; i < tenths; i++)
+        doSleep();
+    }
+
+    offset = next;
+    if (lunation < NEWMOON_COUNT) lunation++;
+  }
+}
@@ -0,0 +1,124 @@
+/*
+
+ Multi-movement Clock
+ Copyright 2014 Nicholas W. Sayer
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This drives up to four movements from one ATtiny44, each with its own
+ * personality. Build it with -DMOVEMENTS=n and CHIP=attiny44. See doTickMask()
+ * in base.c for how the pulses are kept from overlapping.
+ *
+ * The personalities are the simpler ones from the single clocks, rewritten
+ * to decide one tenth at a time, since they all have to share the one loop.
+ *
+ */
+
+#if defined(UNIT_TEST) && !defined(MOVEMENTS)
+#define MOVEMENTS 4
+#endif
+#ifndef MOVEMENTS
+#error multi.c needs MOVEMENTS
+#endif
+
+#if defined(UNIT_TEST)
+// On *nix, there is no PROGMEM. Just make it go away and turn the
+// pgm_read operations into just pointer derefs.
+#define PROGMEM
+#define pgm_read_byte(x) *(x)
+#else
+#include <avr/pgmspace.h>
+#endif
+
+#include "base.h"
+
+#define NORMAL 0 // normal.c
+#define WHACKY 1 // whacky.c - a random tenth in each second
+#define VETINARI 2 // vetinari.c - the occasional long second, and a stutter to make up for them
+
+// Which personality each movement gets. Override this from the Makefile.
+#ifndef MOVEMENT_KINDS
+#define MOVEMENT_KINDS { NORMAL, WHACKY, VETINARI, NORMAL }
+#endif
+
+struct movement {
+  unsigned char kind;
+  unsigned char tenth; // where we are in this "second"
+  unsigned char length; // how long this "second" is
+  unsigned char tick_at; // the tenth with the tick in it
+  unsigned char extra; // the tenth with an extra tick in it, or 0xff for none
+  unsigned char needed; // vetinari.c's ticks_needed
+};
+
+#define NO_TICK (0xff)
+
+// The start of a new "second". Work out where the ticks go.
+static void newSecond(struct movement *m) {
+  m->tenth = 0;
+  m->length = IRQS_PER_SECOND;
+  m->tick_at = 0;
+  m->extra = NO_TICK;
+  switch(m->kind) {
+    case WHACKY:
+      m->tick_at = q_random() % IRQS_PER_SECOND;
+      break;
+    case VETINARI:
+      if (q_random() % 4) break;
+      // This "second" is 11 tenths long. Every tenth one gets a stutter tick,
+      // in the third tenth, as in vetinari.c (doTick(), doSleep(), doTick()).
+      m->length = IRQS_PER_SECOND + 1;
+      if (--m->needed == 0) {
+        m->extra = 2;
+        m->needed = IRQS_PER_SECOND;
+      }
+      break;
+  }
+}
+
+// Returns non-zero if this movement ticks in this tenth.
+static unsigned char step(struct movement *m) {
+  if (m->tenth >= m->length) newSecond(m);
+  unsigned char tick = (m->tenth == m->tick_at || m->tenth == m->extra);
+  m->tenth++;
+  return tick;
+}
+
+void loop() {
+  // In flash, so it isn't copied into RAM.
+  static PROGMEM const unsigned char kinds[] = MOVEMENT_KINDS;
+  struct movement movements[MOVEMENTS];
+
+  // Start each movement at a different point in its second, so the random
+  // numbers get picked in different tenths, and the normal ones don't all
+  // want to tick at once.
+  for(unsigned char i = 0; i < MOVEMENTS; i++) {
+    movements[i].kind = pgm_read_byte(kinds + i);
+    movements[i].needed = IRQS_PER_SECOND;
+    newSecond(&movements[i]);
+    movements[i].tenth = IRQS_PER_SECOND - (i * IRQS_PER_SECOND) / MOVEMENTS;
+  }
+
+  while(1) {
+    unsigned char mask = 0;
+    for(unsigned char i = 0; i < MOVEMENTS; i++)
+      if (step(&movements[i])) mask |= 1 << i;
+    if (mask)
+      doTickMask(mask);
+    else
+      doSleep();
+  }
+}
@@ -0,0 +1,52 @@
+// Generated by host/newmoon.py - don't edit.
+//
+// New moons from 2020-01-24 21:42 UTC (entry 0) through 2069. Entry n is how far
+// that new moon is from NEWMOON_EPOCH plus n mean months, in units of
+// NEWMOON_UNIT tenths-of-a-second.
+
+#define NEWMOON_EPOCH (1579926691L) // seconds since 1970 (UTC)
+#define MEAN_LUNATION (25514429L) // tenths-of-a-second
+#define NEWMOON_UNIT (4800) // 8 minutes
+#define NEWMOON_COUNT (618)
+
+PROGMEM const signed char newmoon_offset[NEWMOON_COUNT] = {
+  -51, -13, 26, 58, 76, 79, 65, 38, 5, -27, -51, -62, -62, -52, -33, -8,
+  20, 44, 57, 55, 42, 24, 4, -13, -27, -38, -45, -45, -35, -17, 2, 20,
+  32, 39, 40, 35, 25, 9, -10, -28, -43, -51, -51, -42, -24, 1, 27, 48,
+  58, 56, 43, 23, -3, -31, -57, -75, -78, -63, -32, 7, 43, 69, 79, 75,
+  56, 25, -15, -54, -84, -98, -90, -62, -19, 27, 68, 93, 98, 81, 47, 3,
+  -41, -78, -100, -102, -84, -45, 6, 57, 93, 105, 93, 63, 22, -20, -59, -88,
+  -100, -92, -62, -15, 35, 74, 93, 91, 72, 41, 3, -35, -67, -84, -84, -65,
+  -32, 6, 41, 66, 76, 71, 51, 21, -10, -37, -54, -60, -56, -43, -22, 3,
+  29, 48, 54, 48, 34, 16, -1, -16, -29, -40, -45, -42, -30, -12, 7, 23,
+  34, 40, 41, 35, 22, 4, -17, -35, -49, -55, -52, -38, -16, 12, 39, 57,
+  62, 55, 37, 13, -16, -45, -70, -82, -76, -52, -14, 27, 60, 79, 82, 69,
+  43, 6, -36, -73, -96, -99, -79, -42, 5, 50, 85, 100, 93, 66, 25, -21,
+  -62, -92, -104, -95, -66, -20, 33, 78, 102, 101, 78, 42, 0, -41, -74, -95,
+  -97, -78, -38, 11, 56, 84, 92, 81, 56, 21, -16, -50, -75, -83, -74, -48,
+  -13, 23, 52, 69, 72, 60, 36, 6, -22, -44, -55, -56, -49, -34, -13, 12,
+  35, 48, 50, 41, 26, 10, -4, -18, -31, -42, -45, -40, -26, -8, 11, 26,
+  37, 43, 42, 33, 17, -4, -25, -44, -56, -58, -51, -32, -4, 26, 51, 65,
+  64, 50, 28, -1, -32, -61, -81, -85, -69, -36, 7, 47, 74, 85, 80, 59,
+  25, -16, -57, -88, -102, -93, -63, -19, 30, 71, 97, 100, 82, 46, 1, -43,
+  -80, -100, -102, -82, -43, 8, 58, 93, 104, 91, 60, 20, -21, -58, -85, -97,
+  -88, -58, -13, 35, 71, 89, 86, 68, 38, 3, -33, -62, -78, -78, -60, -30,
+  4, 35, 58, 69, 65, 48, 22, -7, -31, -46, -53, -51, -42, -26, -4, 20,
+  38, 47, 45, 35, 21, 7, -7, -21, -35, -44, -46, -38, -22, -3, 16, 31,
+  42, 46, 43, 30, 11, -13, -35, -52, -62, -60, -47, -22, 10, 41, 62, 69,
+  62, 43, 16, -16, -48, -75, -88, -83, -56, -15, 29, 64, 84, 87, 73, 44,
+  5, -38, -76, -100, -102, -81, -42, 7, 54, 88, 102, 94, 65, 23, -23, -64,
+  -92, -103, -94, -63, -17, 35, 78, 101, 99, 76, 40, -2, -41, -72, -91, -93,
+  -74, -36, 11, 54, 80, 87, 76, 52, 20, -15, -46, -69, -77, -68, -45, -14,
+  18, 45, 61, 65, 56, 35, 9, -17, -36, -47, -49, -46, -35, -18, 4, 25,
+  40, 45, 40, 30, 17, 4, -10, -25, -39, -47, -46, -35, -17, 3, 21, 37,
+  47, 49, 42, 25, 2, -23, -46, -61, -66, -59, -39, -9, 26, 55, 71, 71,
+  56, 32, 0, -34, -65, -86, -91, -74, -38, 7, 50, 79, 90, 84, 61, 25,
+  -18, -60, -92, -105, -95, -63, -17, 32, 74, 99, 102, 82, 45, -1, -45, -80,
+  -100, -100, -80, -41, 10, 59, 92, 102, 88, 57, 18, -22, -57, -82, -92, -83,
+  -55, -12, 33, 67, 83, 81, 63, 36, 3, -30, -56, -71, -71, -56, -29, 1,
+  29, 50, 61, 59, 46, 23, -2, -23, -38, -45, -46, -41, -30, -12, 10, 29,
+  41, 42, 36, 26, 15, 2, -14, -30, -44, -50, -45, -31, -12, 9, 28, 44,
+  52, 51, 39, 17, -9, -35, -56, -68, -68, -55, -28, 8, 43, 68, 76, 68,
+  48, 18, -17, -51, -80, -94, -88, -60, -16, 31,
+};
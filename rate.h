@@ -0,0 +1,94 @@
+/*
+
+ Variable rate clock common code
+ Copyright 2014 Nicholas W. Sayer
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This is common code for clocks that run at some rate other than true
+ * time, and maybe change it as they go. Include it and call rateTenth()
+ * in place of doTick() or doSleep().
+ *
+ * It's a phase accumulator. Each tenth, the hand's time moves on by
+ * RATE_UNIT plus the rate, and when that comes to a whole second
+ * (RATE_SECOND) the clock ticks. The rate is in millionths, so +100000 is
+ * 10% fast, and any rate at all can be had to the ppm. It's a 32 bit add and
+ * compare a tenth, and never anything but the one doSleep() or doTick().
+ *
+ * The rate changes RATE_RAMP a tenth at most, so that moving from one rate
+ * to another is a smooth ramp rather than a step. Once it's going, the
+ * spacing of the ticks never changes by more than a tenth from one to the
+ * next.
+ *
+ * Nothing is ever rounded, so the hand's lead on true time is exactly the
+ * sum of the rates over every tenth so far, in RATE_UNITs of a tenth.
+ * rateRun() ramps to a rate, holds it and ramps back to true time, and adds
+ * exactly rate * tenths to that, however the ramps go. So a clock whose
+ * rateRun() calls add up to nothing comes back to exactly where the hand
+ * started, to the ppm of a tenth, for as long as it runs.
+ *
+ * drift.h uses it with a fixed rate, and with RATE_UNIT and RATE_SECOND
+ * chosen to make its fraction exact.
+ */
+
+#include "base.h"
+
+#ifndef RATE_UNIT
+#define RATE_UNIT (1000000L)
+#endif
+#ifndef RATE_SECOND
+#define RATE_SECOND (RATE_UNIT * IRQS_PER_SECOND)
+#endif
+// In RATE_UNITs per tenth per tenth. At 100 ppm, it takes 1000 tenths to
+// ramp to 10% fast.
+#ifndef RATE_RAMP
+#define RATE_RAMP (100)
+#endif
+
+static long rate_now, rate_target;
+// How far into the second we are, less the RATE_SECOND - RATE_UNIT it starts
+// at, so that the first tick is due right away. Keeping the offset out of
+// the variable lets it start at 0, in .bss.
+static long rate_phase;
+
+static void rateTenth() {
+  if (rate_now != rate_target) {
+    long step = rate_target - rate_now;
+    if (step > RATE_RAMP) step = RATE_RAMP;
+    else if (step < -RATE_RAMP) step = -RATE_RAMP;
+    rate_now += step;
+  }
+  rate_phase += RATE_UNIT + rate_now;
+  if (rate_phase >= RATE_UNIT) { // that's RATE_SECOND, without the offset
+    rate_phase -= RATE_SECOND;
+    doTick();
+  } else {
+    doSleep();
+  }
+}
+
+// Ramp to 'rate', run for 'tenths' tenths from the start of the ramp, and
+// ramp back to true time. For the lead to come out as exactly rate * tenths,
+// 'rate' has to be a multiple of RATE_RAMP, and 'tenths' has to be long
+// enough for the first ramp to finish. That takes rate / RATE_RAMP tenths,
+// and so does the one back, which comes after 'tenths'.
+static inline void rateRun(long rate, unsigned long tenths) {
+  rate_target = rate;
+  while(tenths--) rateTenth();
+  rate_target = 0;
+  while(rate_now != 0) rateTenth();
+}
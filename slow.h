@@ -41,10 +41,9 @@ void loop() {
 #ifndef UNIT_TEST
   // When the battery is installed, do a whole bunch of really fast
   // ticking as a proof of life.
-  for(int i = 0; i < START_TICKS; i++) {
-    doTick();
+  // The burst stops at its last tick; sleep out the rest of the 30 s.
+  for(unsigned int i = doTickBurst(START_TICKS, 200); i < START_TICKS * 2; i++)
     doSleep();
-  }
 #endif
 
   while(1) {
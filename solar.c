@@ -0,0 +1,104 @@
+/*
+
+ Solar (sundial) Clock
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// This clock keeps apparent solar time - the time a sundial shows. That's
+// mean time plus the equation of time, which wanders between about 14
+// minutes slow in February and 16 minutes fast in November.
+//
+// eot.h (made by host/eot.py) says how much the equation of time changes
+// each day, in half seconds. That much is spread evenly over the day, the
+// same way drift.h does it: a tenth-of-a-second is skipped or repeated every
+// so often. Which tenths is decided by a phase accumulator, so it's all just
+// additions.
+//
+// The clock starts at midnight UTC on table day START_DAY, set to sundial
+// time. 'eot.py --when' gives both. The table is a 365 day year, and an extra
+// day with no change is put in at day 0 every 4 years or so to keep up with
+// the seasons.
+
+#if defined(UNIT_TEST)
+// On *nix, there is no PROGMEM. Just make it go away and turn the
+// pgm_read operations into just pointer derefs.
+#define PROGMEM
+#define pgm_read_byte(x) *(x)
+#else
+#include <avr/pgmspace.h>
+#endif
+
+#include "base.h"
+#include "eot.h"
+
+#ifndef START_DAY
+#define START_DAY 0
+#endif
+
+#define TENTHS_PER_DAY (864000L)
+// A year is 365.2422 days.
+#define LEAP_PART (2422)
+#define LEAP_WHOLE (10000)
+
+void loop() {
+  unsigned int day = START_DAY;
+  unsigned long tenth = 0; // of the day
+  unsigned long phase = 0;
+  unsigned int leap_position = 0;
+  unsigned char held = 0;
+  unsigned char tick_counter = IRQS_PER_SECOND - 1; // tick right away
+  int change = (signed char)pgm_read_byte(eot_change + day) * EOT_UNIT;
+  while(1) {
+    // Usually, the hands move a tenth this tenth. 'change' times a day,
+    // they move two (when the sundial is gaining) or none (when it's losing).
+    unsigned char steps = 1;
+    if (change != 0) {
+      phase += change > 0 ? change : -change;
+      if (phase >= TENTHS_PER_DAY) {
+        phase -= TENTHS_PER_DAY;
+        steps = change > 0 ? 2 : 0;
+      }
+    }
+    unsigned char tick = 0;
+    while(steps--) {
+      if (++tick_counter >= IRQS_PER_SECOND) {
+        tick_counter = 0;
+        tick = 1;
+      }
+    }
+    if (tick)
+      doTick();
+    else
+      doSleep();
+
+    if (++tenth >= TENTHS_PER_DAY) {
+      tenth = 0;
+      unsigned int next = day + 1;
+      if (next >= EOT_DAYS) next = 0;
+      if (next == 0 && !held && (leap_position += LEAP_PART) >= LEAP_WHOLE) {
+        // Stay put for a day.
+        leap_position -= LEAP_WHOLE;
+        held = 1;
+        change = 0;
+      } else {
+        held = 0;
+        day = next;
+        change = (signed char)pgm_read_byte(eot_change + day) * EOT_UNIT;
+      }
+    }
+  }
+}
@@ -0,0 +1,19 @@
+// Generated by host/rhythm.py from host/songs.txt - don't edit.
+//
+// Each song is its lead-in, in tenths, then the pauses between its ticks,
+// low nibble first, ending with a 0. tuney.c works out the lead-out.
+
+#define SONG_COUNT (4)
+
+PROGMEM const unsigned char songs[24] = {
+  // shave: "Shave-and-a-haircut... two bits!" - 8 ticks, lead-in 27, lead-out 27
+  27, 0x13, 0x31, 0x37, 0x00,
+  // backbeat: Backbeat from "Heart Of Rock-n-Roll" - 13 ticks, lead-in 36, lead-out 36
+  36, 0x15, 0x57, 0x71, 0x15, 0x57, 0x01,
+  // sos: SOS in morse - 10 ticks, lead-in 23, lead-out 35
+  23, 0x22, 0x64, 0x86, 0x22, 0x00,
+  // imperialmarch: Star Wars Imperial March - 10 ticks, lead-in 32, lead-out 32
+  32, 0x55, 0x25, 0x51, 0x12, 0x00,
+};
+
+PROGMEM const unsigned char song_start[SONG_COUNT] = { 0, 5, 12, 18 };
@@ -0,0 +1,20 @@
+// Generated by host/steps.py - don't edit.
+//
+// Each step is a tick pattern, a bit a tenth, low bit first. Step 2n and
+// 2n + 1 are a pair, which run for the same time and keep time between them.
+
+#define STEP_SECONDS (6)
+#define STEP_TENTHS (60)
+#define STEP_BYTES (8)
+#define SPEED_PAIRS (4)
+
+PROGMEM const unsigned char steps[64] = {
+  0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, // slow, 2 ticks
+  0x41, 0x10, 0x04, 0x41, 0x10, 0x04, 0x41, 0x00, // fast, 10 ticks
+  0x01, 0x04, 0x10, 0x40, 0x00, 0x01, 0x04, 0x00, // normal, 6 ticks
+  0x01, 0x04, 0x10, 0x40, 0x00, 0x01, 0x04, 0x00, // normal, 6 ticks
+  0x01, 0x00, 0x10, 0x00, 0x00, 0x01, 0x00, 0x00, // half, 3 ticks
+  0x41, 0x20, 0x10, 0x04, 0x02, 0x41, 0x20, 0x00, // half again, 9 ticks
+  0x01, 0x80, 0x00, 0x40, 0x00, 0x20, 0x00, 0x00, // two thirds, 4 ticks
+  0x81, 0x80, 0x40, 0x40, 0x20, 0x20, 0x10, 0x00, // four thirds, 8 ticks
+};
@@ -0,0 +1,56 @@
+/*
+
+ Crazy Clock telemetry frame
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * With TELEMETRY, base.c sends one of these out of PB2 every
+ * TELEMETRY_INTERVAL, as 8N1 serial at TELEMETRY_BAUD. It goes out one byte
+ * per tenth, in whatever time the clock code leaves over. Everything is
+ * little-endian, and the bytes of a frame add up to 0.
+ *
+ * This is kept separate from base.c so that the host decoder can use it.
+ */
+
+#include <stdint.h>
+
+#define TELEMETRY_BAUD (300)
+// A minute, in tenths-of-a-second.
+#define TELEMETRY_INTERVAL (600)
+#define TELEMETRY_SYNC (0xa5)
+// In place of the battery level, without BATTERY_MONITOR.
+#define TELEMETRY_NO_BATTERY (0xff)
+
+struct telemetry_frame {
+  uint8_t sync;
+  uint8_t sequence; // counts up by one each frame
+  uint32_t wakes; // timer interrupts since reset
+  uint16_t overrun_max; // these two are as saved in EEPROM
+  uint32_t overrun_total;
+  uint16_t saves; // daily seed saves since reset
+  int16_t trim; // in use now, with any temperature correction
+  uint8_t battery; // see battery.h
+  uint8_t check; // makes the sum of the bytes 0
+} __attribute__((packed));
+
+static inline uint8_t telemetrySum(const void *frame) {
+  const uint8_t *p = frame;
+  uint8_t sum = 0;
+  for(uint8_t i = 0; i < sizeof(struct telemetry_frame); i++) sum += p[i];
+  return sum;
+}
@@ -0,0 +1,53 @@
+/*
+
+ Crazy Clock temperature compensation
+ Copyright 2014 Nicholas W. Sayer
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A tuning fork crystal has a parabolic temperature curve. At the turnover
+ * point (nominally 25 C) it's at its fastest, and on either side of that it
+ * slows down by 0.034 ppm per degree squared. The internal temperature sensor
+ * reads about 1 LSB per degree, so the difference between a reading and the
+ * reading at the turnover point is the temperature delta in degrees.
+ *
+ * This is kept separate from base.c so that the host model can check the
+ * math without any hardware.
+ */
+
+// How often to sample the temperature, in tenths-of-a-second. 5 minutes.
+#define TEMP_SAMPLE_INTERVAL (3000)
+
+// If there's no calibration value in EEPROM, use this as the sensor reading at
+// the turnover temperature. It's the datasheet typical value for 25 C.
+#define TEMP_DEFAULT_CAL (300)
+
+// Beyond this, either the sensor or the calibration is bogus, or the clock
+// has bigger problems than the crystal.
+#define TEMP_MAX_DELTA (60)
+
+// Returns the correction in tenths-of-a-ppm to add to the trim value.
+// 0.34 tenth-ppm per degree squared is done as 1/4 + 1/16 + 1/32 = 0.34375,
+// because the chip has no multiplier worth speaking of.
+static inline int tempCorrection(int reading, int cal) {
+  int delta = reading - cal;
+  if (delta < 0) delta = -delta;
+  if (delta > TEMP_MAX_DELTA) delta = TEMP_MAX_DELTA;
+  unsigned int square = (unsigned int)(delta * delta);
+  // The crystal is running slow, so we must speed the clock up. That's a negative trim.
+  return -(int)((square >> 2) + (square >> 4) + (square >> 5));
+}
@@ -52,20 +52,30 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "host/hoststubs.h"
+
 extern void loop();
 
-unsigned int q_random() {
+unsigned long q_random() {
   return random();
 }
 
 void doSleep() {
+  host_run_tasks();
   printf("Sleep\n");
 }
 
 void doTick() {
+  host_run_tasks();
   printf("Tick\n");
 }
 
+// For multi.c. The mask says which movements ticked in this tenth.
+void doTickMask(unsigned char mask) {
+  host_run_tasks();
+  printf("Tick %x\n", mask);
+}
+
 int main(int argc, char **argv) {
   srandom(time(NULL));
   while(1) loop();
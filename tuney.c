@@ -30,35 +30,19 @@
 // pgm_read operations into just pointer derefs.
 #define PROGMEM
 #define pgm_read_byte(x) *(x)
-#define pgm_read_ptr(x) ((void*)(*(x)))
-#define PGM_VOID_P void*
 #else
 #include <avr/pgmspace.h>
-#ifndef pgm_read_ptr
-#define pgm_read_ptr pgm_read_word
-#endif
 #endif
 
 #include "base.h"
 
-// Each "song" is a series of pause counts - the pause between the ticks
-// that make up the rhythm in question. To insure that the clock keeps
-// proper time, the sum of the elements in each table must equal 9 times
-// the number of elements in the table. The last element should be zero
-// to mark the end.
-
-// "Shave-and-a-haircut... two bits!"
-PROGMEM const unsigned char shave_table[] = { 27, 3, 1, 1, 3, 7, 3, 27, 0 };
-// Backbeat from "Heart Of Rock-n-Roll"
-PROGMEM const unsigned char backbeat_table[] = { 36, 5, 1, 7, 5, 1, 7, 5, 1, 7, 5, 1, 36, 0 };
-// SOS in morse
-PROGMEM const unsigned char sos_table[] = { 23, 2, 2, 4, 6, 6, 8, 2, 2, 35, 0};
-// Star Wars Imperial March
-PROGMEM const unsigned char imperialmarch_table[] = { 32, 5, 5, 5, 2, 1, 5, 2, 1, 32, 0};
-
-PROGMEM PGM_VOID_P const song_table[] = { (PGM_VOID_P)&shave_table, (PGM_VOID_P)&backbeat_table, (PGM_VOID_P)&sos_table, (PGM_VOID_P)&imperialmarch_table };
-
-#define SONG_COUNT 4
+// Each "song" is a lead-in - the pause after an ordinary tick - and then the
+// pauses between the ticks that make up the rhythm in question, two to a
+// byte. They're compiled into songs.h by host/rhythm.py, from
+// host/songs.txt. The pause after the last tick isn't in the table. Every
+// tick owes the rest of its second, and the lead-out pays back whatever is
+// still owed, so a song always takes exactly a second per tick.
+#include "songs.h"
 
 void loop() {
   while(1) {
@@ -73,13 +57,27 @@ void loop() {
 
     // Time to play a song!
     unsigned int song = q_random() % SONG_COUNT;
-    unsigned char *current_song = (unsigned char*)pgm_read_ptr(song_table + song);
+    const unsigned char *current_song = songs + pgm_read_byte(song_start + song);
+    unsigned char song_data = pgm_read_byte(current_song++); // the lead-in
+    unsigned char nibble = 0;
+    int owed = 0;
     while(1) {
-      unsigned char song_data = pgm_read_byte(current_song++);
-      if (song_data == 0) break; // song over
       doTick();
+      owed += IRQS_PER_SECOND - 1 - song_data;
       for(int i = 0; i < song_data; i++)
         doSleep();
+      unsigned char packed = pgm_read_byte(current_song);
+      if (nibble++ & 1) {
+        song_data = packed >> 4;
+        current_song++;
+      } else {
+        song_data = packed & 0xf;
+      }
+      if (song_data == 0) break; // song over
     }
+    // The last tick, and the lead-out.
+    doTick();
+    for(int i = 0; i < owed + IRQS_PER_SECOND - 1; i++)
+      doSleep();
   }
 }
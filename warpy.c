@@ -22,28 +22,28 @@
  * This clock runs 10% fast for 12 hours, then 10% slow for 12 hours. Makes the
  * day fly right by!
  *
+ * The changes of speed are ramps, about 17 minutes long, rather than jumps.
+ * Each half of the day is the other's mirror image, so the clock is right
+ * again every 24 hours, exactly.
  */
 
-#include "base.h"
+// Ramping at 10 ppm a tenth, it takes this long to go from true time to 10%
+// either way.
+#define RATE_RAMP (10)
 
-// 12 hours in seconds
-#define CYCLE_LENGTH (60L*60*12)
-// This is a multiple of 10% for how much swing we give
-#define CYCLE_MAGNITUDE (1)
+#include "rate.h"
+
+// 12 hours in tenths
+#define CYCLE_LENGTH (60L*60*12*IRQS_PER_SECOND)
+// In millionths, how much swing we give
+#define CYCLE_RATE (100000L)
+
+#if CYCLE_RATE % RATE_RAMP != 0
+#error The rate has to be a whole number of ramp steps
+#endif
 
 void loop() {
-  unsigned char cycle_direction = 0; // fast
-  unsigned long cycle_position = 0;
-  while(1) {
-    for(unsigned char i = 0; i < IRQS_PER_SECOND + (CYCLE_MAGNITUDE * (cycle_direction?-1:1)); i++) {
-      if (i == 0)
-        doTick();
-      else
-        doSleep();
-    }
-    if (cycle_position++ >= CYCLE_LENGTH) {
-      cycle_position = 0;
-      cycle_direction = !cycle_direction;
-    }
-  }
-} 
+  // rateRun() ramps back for CYCLE_RATE / RATE_RAMP tenths after it's done.
+  rateRun(CYCLE_RATE, CYCLE_LENGTH - CYCLE_RATE / RATE_RAMP);
+  rateRun(-CYCLE_RATE, CYCLE_LENGTH - CYCLE_RATE / RATE_RAMP);
+}